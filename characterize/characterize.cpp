@@ -0,0 +1,326 @@
+// Composite characterization tool running the lab0-lab2 analyses in one
+// Pin run:
+//
+//   pin -t characterize.so -count inscount.out -deps result.csv
+//       -caches caches.out -bpout bpredictor.out -- <benchmark>
+//
+// Each analysis is enabled by naming its output file, which it writes in
+// the format of its own tool:
+//
+//   -count    instruction count, as inscount0 -bbl
+//   -deps     register (and with -mem, memory) dependency spacing, as regDeps,
+//             with its -s/-mem/-shadow knobs and -ilp/-w/-phase report
+//   -caches   the three lab1 cache models, as caches, with -m/-p/-r/-b/-a/-lru/-tlbe/-tlba
+//   -bpout    the branch predictor named by -bp, as bpredictor -bp, the
+//             Alpha 21264 by default
+//
+// All of them share one Trace instrumentation pass.
+// Counting and the dependency analyses update per-thread state inline;
+// memory references and conditional branch outcomes go in order through
+// one per-thread Pin trace buffer that is drained into the cache models
+// and the branch predictor, which are shared, under one lock.
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+#include "pin.H"
+#include "reg_deps.h"
+#include "branch_predictors.h"
+#include "cache_models.h"
+
+// This knob will enable instruction counting and set its output file name
+KNOB<string> KnobCountFile(KNOB_MODE_WRITEONCE, "pintool",
+        "count", "", "specify file name for the instruction count (empty to disable)");
+
+// This knob will enable the regDeps analyses and set their output file name
+KNOB<string> KnobDepsFile(KNOB_MODE_WRITEONCE, "pintool",
+        "deps", "", "specify file name for the dependency spacing histogram (empty to disable)");
+
+// This knob will enable the cache models and set their output file name
+KNOB<string> KnobCachesFile(KNOB_MODE_WRITEONCE, "pintool",
+        "caches", "", "specify file name for the cache model results (empty to disable)");
+
+// This knob will enable the branch predictor and set its output file name
+KNOB<string> KnobBpFile(KNOB_MODE_WRITEONCE, "pintool",
+        "bpout", "", "specify file name for the branch predictor results (empty to disable)");
+
+// This knob will select the branch predictor configuration, as bpredictor's -bp
+KNOB<string> KnobPredictor(KNOB_MODE_WRITEONCE, "pintool",
+        "bp", "alpha21264", string("specify the predictor -bpout runs: ") + BRANCH_PREDICTOR_NAMES);
+
+// This knob will set the per-thread event buffer size
+KNOB<UINT32> KnobBufferPages(KNOB_MODE_WRITEONCE, "pintool",
+        "buf", "64", "specify the per-thread event buffer size in pages");
+
+// These knobs mirror regDeps
+KNOB<string> KnobMaxSpacing(KNOB_MODE_WRITEONCE, "pintool",
+        "s", "100", "specify the maximum spacing between two dependant instructions in the program");
+KNOB<string> KnobIlpFile(KNOB_MODE_WRITEONCE, "pintool",
+        "ilp", "", "specify file name for the dataflow-limit critical path and ILP report (requires -deps)");
+KNOB<UINT32> KnobWindow(KNOB_MODE_WRITEONCE, "pintool",
+        "w", "128", "specify the instruction window (ROB) size of the windowed dataflow machine");
+KNOB<UINT64> KnobPhase(KNOB_MODE_WRITEONCE, "pintool",
+        "phase", "100000000", "specify the number of instructions per dataflow-limit phase");
+KNOB<BOOL> KnobMemoryDeps(KNOB_MODE_WRITEONCE, "pintool",
+        "mem", "0", "also count the spacing between a store and the loads reading it");
+KNOB<UINT32> KnobShadowPages(KNOB_MODE_WRITEONCE, "pintool",
+        "shadow", "4096", "specify the number of pages in the shadow memory table (a power of two)");
+
+// These knobs mirror caches
+KNOB<UINT32> KnobLogPhysicalMemSize(KNOB_MODE_WRITEONCE, "pintool",
+        "m", "28", "specify the log of physical memory size in bytes");
+KNOB<UINT32> KnobLogPageSize(KNOB_MODE_WRITEONCE, "pintool",
+        "p", "12", "specify the log of page size in bytes");
+KNOB<UINT32> KnobLogNumRows(KNOB_MODE_WRITEONCE, "pintool",
+        "r", "10", "specify the log of number of rows in the cache");
+KNOB<UINT32> KnobLogBlockSize(KNOB_MODE_WRITEONCE, "pintool",
+        "b", "5", "specify the log of block size of the cache in bytes");
+KNOB<UINT32> KnobAssociativity(KNOB_MODE_WRITEONCE, "pintool",
+        "a", "2", "specify the associativity of the cache");
+KNOB<string> KnobRecency(KNOB_MODE_WRITEONCE, "pintool",
+        "lru", "age", "specify the replacement policy: queue, age, matrix, plru, random, fifo, nru, srrip or brrip");
+KNOB<UINT32> KnobTlbEntries(KNOB_MODE_WRITEONCE, "pintool",
+        "tlbe", "0", "specify the number of TLB entries (0 for no TLB)");
+KNOB<UINT32> KnobTlbAssociativity(KNOB_MODE_WRITEONCE, "pintool",
+        "tlba", "4", "specify the associativity of the TLB");
+
+// One entry of the per-thread event buffer
+enum EventKind { EVENT_LOAD, EVENT_STORE, EVENT_BRANCH };
+struct Event
+{
+    UINT64 addr;    // effective address, or the branch's address
+    UINT32 kind;
+    UINT32 taken;   // EVENT_BRANCH only
+};
+BUFFER_ID eventBuffer = BUFFER_ID_INVALID;
+PIN_LOCK eventLock;
+
+// -count: per-thread instruction counts, padded to a host cache line
+static const UINT32 MAX_COUNT_THREADS = 256;
+struct ThreadCount
+{
+    UINT64 count;
+    UINT8 pad[CACHE_ALIGNMENT - sizeof(UINT64)];
+} __attribute__((aligned(CACHE_ALIGNMENT)));
+ThreadCount threadCounts[MAX_COUNT_THREADS];
+bool counting = false;
+
+// -deps
+bool regDeps = false;
+// declared by reg_deps.h
+ThreadDeps* threadDeps[MAX_THREADS];
+INT32 maxSize;
+bool ilp = false;
+bool memDeps = false;
+uint32_t window;
+uint64_t phaseLength;
+uint32_t shadowPages;
+
+// -caches
+CacheSimulator* cacheSim = NULL;
+UINT32 logPageSize;             // declared by cache_models.h
+UINT32 logPhysicalMemSize;
+
+// -bpout
+BranchPredictor* BP = NULL;
+UINT64 takenCorrect = 0;
+UINT64 takenIncorrect = 0;
+UINT64 notTakenCorrect = 0;
+UINT64 notTakenIncorrect = 0;
+
+VOID PIN_FAST_ANALYSIS_CALL docountBbl(THREADID tid, UINT32 numIns)
+{
+    threadCounts[tid].count += numIns;
+}
+
+// Same bookkeeping as bpredictor's handleBranch
+VOID handleBranch(ADDRINT ip, BOOL direction)
+{
+    BOOL prediction = BP->makePrediction(ip);
+    BP->makeUpdate(direction, prediction, ip);
+    if (prediction) {
+        if (direction)
+            takenCorrect++;
+        else
+            takenIncorrect++;
+    } else {
+        if (direction)
+            notTakenIncorrect++;
+        else
+            notTakenCorrect++;
+    }
+}
+
+// Pin calls this function when a thread's event buffer fills up and when
+// the thread exits. The events of one thread stay in program order.
+VOID* BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf, UINT64 numElements, VOID *v)
+{
+    const Event* events = (const Event*) buf;
+    PIN_GetLock(&eventLock, tid + 1);
+    for (UINT64 i = 0; i < numElements; i++) {
+        switch (events[i].kind) {
+            case EVENT_LOAD:  cacheSim->load(cacheSim, (UINT32) events[i].addr); break;
+            case EVENT_STORE: cacheSim->store(cacheSim, (UINT32) events[i].addr); break;
+            default:          handleBranch(events[i].addr, events[i].taken); break;
+        }
+    }
+    PIN_ReleaseLock(&eventLock);
+    return buf;
+}
+
+// Inserts the per-instruction analyses and the event buffer fills of ins
+VOID Instruction(INS ins)
+{
+    if (regDeps)
+        instrumentRegDeps(ins);
+
+    if (cacheSim) {
+        if (INS_IsMemoryRead(ins))
+            INS_InsertFillBuffer(ins, IPOINT_BEFORE, eventBuffer,
+                    IARG_MEMORYREAD_EA, offsetof(Event, addr),
+                    IARG_UINT32, EVENT_LOAD, offsetof(Event, kind), IARG_END);
+        if (INS_IsMemoryWrite(ins))
+            INS_InsertFillBuffer(ins, IPOINT_BEFORE, eventBuffer,
+                    IARG_MEMORYWRITE_EA, offsetof(Event, addr),
+                    IARG_UINT32, EVENT_STORE, offsetof(Event, kind), IARG_END);
+    }
+
+    // The conditional branches bpredictor sees, with their outcome known
+    // before they execute
+    if (BP && INS_IsBranch(ins) && INS_HasFallThrough(ins))
+        INS_InsertFillBuffer(ins, IPOINT_BEFORE, eventBuffer,
+                IARG_INST_PTR, offsetof(Event, addr),
+                IARG_UINT32, EVENT_BRANCH, offsetof(Event, kind),
+                IARG_BRANCH_TAKEN, offsetof(Event, taken), IARG_END);
+}
+
+// Pin calls this function every time a new trace is encountered, the one
+// instrumentation pass of every analysis. As in inscount0 -bbl, each block
+// adds its instruction count in one call and REP-prefixed instructions
+// count every iteration.
+VOID Trace(TRACE trace, VOID *v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        UINT32 numIns = BBL_NumIns(bbl);
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+            Instruction(ins);
+            if (counting && INS_HasRealRep(ins)) {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docountBbl, IARG_FAST_ANALYSIS_CALL,
+                        IARG_THREAD_ID, IARG_UINT32, 1, IARG_END);
+                numIns--;
+            }
+        }
+        if (counting && numIns)
+            INS_InsertCall(BBL_InsHead(bbl), IPOINT_BEFORE, (AFUNPTR)docountBbl, IARG_FAST_ANALYSIS_CALL,
+                    IARG_THREAD_ID, IARG_UINT32, numIns, IARG_END);
+    }
+}
+
+// Pin calls this function when a thread starts, before it runs any
+// analysis routine
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    assert(tid < MAX_COUNT_THREADS);
+    if (regDeps)
+        startRegDeps(tid);
+}
+
+// This function is called when the application exits
+VOID Fini(INT32 code, VOID *v)
+{
+    FILE* outfile;
+    if (counting) {
+        UINT64 icount = 0;
+        for (UINT32 tid = 0; tid < MAX_COUNT_THREADS; tid++)
+            icount += threadCounts[tid].count;
+        assert(outfile = fopen(KnobCountFile.Value().c_str(),"w"));
+        fprintf(outfile, "Count: %lu\n", icount);
+        fclose(outfile);
+    }
+    if (regDeps) {
+        assert(outfile = fopen(KnobDepsFile.Value().c_str(),"w"));
+        dumpDependencySpacing(outfile);
+        fclose(outfile);
+        if (ilp) {
+            assert(outfile = fopen(KnobIlpFile.Value().c_str(),"w"));
+            dumpDataflow(outfile);
+            fclose(outfile);
+        }
+    }
+    if (cacheSim) {
+        assert(outfile = fopen(KnobCachesFile.Value().c_str(),"w"));
+        cacheSim->dumpResults(outfile);
+        fclose(outfile);
+    }
+    if (BP) {
+        assert(outfile = fopen(KnobBpFile.Value().c_str(),"w"));
+        fprintf(outfile, "takenCorrect %lu  takenIncorrect %lu notTakenCorrect %lu notTakenIncorrect %lu\n", takenCorrect, takenIncorrect, notTakenCorrect, notTakenIncorrect);
+        fclose(outfile);
+    }
+}
+
+// argc, argv are the entire command line, including pin -t <toolname> -- ...
+int main(int argc, char * argv[])
+{
+    // Initialize pin
+    PIN_Init(argc, argv);
+
+    counting = !KnobCountFile.Value().empty();
+
+    regDeps = !KnobDepsFile.Value().empty();
+    maxSize = atoi(KnobMaxSpacing.Value().c_str());
+    ilp = !KnobIlpFile.Value().empty();
+    memDeps = KnobMemoryDeps.Value();
+    window = KnobWindow.Value();
+    phaseLength = KnobPhase.Value();
+    shadowPages = KnobShadowPages.Value();
+    assert(maxSize > 0 && window > 0 && phaseLength > 0);
+    if (ilp && !regDeps) {
+        fprintf(stderr, "characterize: -ilp extends the -deps analysis, so it requires -deps\n");
+        return 1;
+    }
+
+    if (!KnobCachesFile.Value().empty()) {
+        logPageSize = KnobLogPageSize.Value();
+        logPhysicalMemSize = KnobLogPhysicalMemSize.Value();
+        CacheConfig config;
+        config.logNumRows = KnobLogNumRows.Value();
+        config.logBlockSize = KnobLogBlockSize.Value();
+        config.associativity = KnobAssociativity.Value();
+        config.recency = parseRecencyPolicy(KnobRecency.Value().c_str());
+        // opt needs its own lookahead over a single stream
+        assert(config.recency != RECENCY_INVALID && config.recency != RECENCY_OPT);
+        config.tlbEntries = KnobTlbEntries.Value();
+        config.tlbAssociativity = KnobTlbAssociativity.Value();
+        cacheSim = makeCacheSimulator(config);
+    }
+
+    if (!KnobBpFile.Value().empty()) {
+        BP = makeBranchPredictor(KnobPredictor.Value().c_str());
+        if (!BP) {
+            fprintf(stderr, "characterize: unknown branch predictor %s, expected one of %s\n",
+                    KnobPredictor.Value().c_str(), BRANCH_PREDICTOR_NAMES);
+            return 1;
+        }
+    }
+
+    if (cacheSim || BP) {
+        PIN_InitLock(&eventLock);
+        eventBuffer = PIN_DefineTraceBuffer(sizeof(Event), KnobBufferPages.Value(), BufferFull, 0);
+        assert(eventBuffer != BUFFER_ID_INVALID);
+    }
+
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+
+    // Register Trace to be called to instrument instructions
+    TRACE_AddInstrumentFunction(Trace, 0);
+
+    // Register Fini to be called when the application exits
+    PIN_AddFiniFunction(Fini, 0);
+
+    // Start the program, never returns
+    PIN_StartProgram();
+
+    return 0;
+}
@@ -1,19 +1,93 @@
 #include <iostream>
+#include <map>
+#include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include "pin.H"
 
 // The running count of instructions is kept here
 UINT64 icount = 0;
 
+// With -bbl every thread counts into its own slot, indexed by THREADID and
+// padded to a host cache line so threads never write the same line. Count
+// is the sum of the slots.
+static const UINT32 MAX_THREADS = 256;
+static const UINT32 CACHE_LINE = 64;
+struct ThreadCount
+{
+    UINT64 count;
+    UINT8 pad[CACHE_LINE - sizeof(UINT64)];
+} __attribute__((aligned(CACHE_LINE)));
+ThreadCount threadCounts[MAX_THREADS];
+
+// Instructions executed in one routine, for -rtn. Records are created
+// when a routine is first instrumented, which fixes its id; count is only
+// filled in by Fini.
+struct RoutineCount
+{
+    string name;
+    string image;
+    UINT64 count;
+};
+std::map<ADDRINT, UINT32> routineIds;              // keyed by routine address
+std::vector<RoutineCount*> routines;               // indexed by routine id
+bool routineReport = false;
+
+// Every thread counts the instructions of each routine into its own
+// table, indexed by routine id, as insmix does for blocks. The table is
+// split into chunks, allocated by ThreadStart for the ids handed out so
+// far and by LookupRoutine for every started thread when it hands out the
+// first id of a chunk. chunkLock keeps the two from interleaving.
+static const UINT32 CHUNK_BITS = 12;
+static const UINT32 CHUNK_MASK = (1u<<CHUNK_BITS) - 1;
+static const UINT32 MAX_CHUNKS = 1024;
+struct ThreadRoutines
+{
+    bool    started;
+    UINT64* chunks[MAX_CHUNKS];
+};
+ThreadRoutines threadRoutines[MAX_THREADS];
+PIN_LOCK chunkLock;
+
 // This knob will set the outfile name
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
 			    "o", "results.out", "specify optional output file name");
 
+// This knob will count whole basic blocks instead of single instructions
+KNOB<BOOL> KnobBbl(KNOB_MODE_WRITEONCE, "pintool",
+			    "bbl", "0", "count once per basic block into per-thread counters");
+
+// This knob will set the per-image and per-routine count file, used with -bbl
+KNOB<string> KnobRoutineFile(KNOB_MODE_WRITEONCE, "pintool",
+			    "rtn", "", "specify file name for per-image and per-routine counts (requires -bbl)");
+
 
 // This function is called before every instruction is executed
 VOID docount() { icount++; }
-    
+
+// With -bbl this function is called before every basic block is executed
+VOID PIN_FAST_ANALYSIS_CALL docountBbl(THREADID tid, UINT32 numIns)
+{
+    threadCounts[tid].count += numIns;
+}
+
+// Same as docountBbl, also charging the instructions to a routine
+VOID PIN_FAST_ANALYSIS_CALL docountBblRoutine(THREADID tid, UINT32 numIns, UINT32 id)
+{
+    threadCounts[tid].count += numIns;
+    threadRoutines[tid].chunks[id >> CHUNK_BITS][id & CHUNK_MASK] += numIns;
+}
+
+// Allocates the chunks of tid holding the ids below numIds; the caller
+// holds chunkLock
+VOID AllocateChunks(THREADID tid, UINT32 numIds)
+{
+    for (UINT32 c = 0; c < (numIds + CHUNK_MASK) >> CHUNK_BITS; c++)
+        if (!threadRoutines[tid].chunks[c])
+            threadRoutines[tid].chunks[c] = (UINT64*) calloc(CHUNK_MASK + 1, sizeof(UINT64));
+}
+
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v)
 {
@@ -21,12 +95,144 @@ VOID Instruction(INS ins, VOID *v)
     INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount, IARG_END);
 }
 
+// Returns the -rtn id of the routine containing addr, creating its record
+// on first use. Instrumentation routines run under the client lock, so the
+// map needs no locking of its own.
+UINT32 LookupRoutine(ADDRINT addr)
+{
+    RTN rtn = RTN_FindByAddress(addr);
+    ADDRINT key = RTN_Valid(rtn) ? RTN_Address(rtn) : 0;
+    std::map<ADDRINT, UINT32>::iterator it = routineIds.find(key);
+    if (it != routineIds.end())
+        return it->second;
+
+    RoutineCount* rc = new RoutineCount;
+    rc->name = RTN_Valid(rtn) ? RTN_Name(rtn) : "[unknown]";
+    rc->image = RTN_Valid(rtn) ? IMG_Name(SEC_Img(RTN_Sec(rtn))) : "[unknown]";
+    rc->count = 0;
+
+    PIN_GetLock(&chunkLock, PIN_ThreadId() + 1);
+    UINT32 id = routines.size();
+    assert((id >> CHUNK_BITS) < MAX_CHUNKS);
+    routines.push_back(rc);
+    if ((id & CHUNK_MASK) == 0)
+        for (THREADID tid = 0; tid < MAX_THREADS; tid++)
+            if (threadRoutines[tid].started)
+                AllocateChunks(tid, id + 1);
+    PIN_ReleaseLock(&chunkLock);
+    routineIds[key] = id;
+    return id;
+}
+
+// Inserts one count of n instructions before ins, charged to routine id
+// unless it is NO_ROUTINE
+static const UINT32 NO_ROUTINE = ~0u;
+VOID InsertCount(INS ins, UINT32 n, UINT32 id)
+{
+    if (id != NO_ROUTINE)
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docountBblRoutine, IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID, IARG_UINT32, n, IARG_UINT32, id, IARG_END);
+    else
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docountBbl, IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID, IARG_UINT32, n, IARG_END);
+}
+
+// With -bbl Pin calls this function every time a new trace is encountered.
+// Each block gets a single call adding its instruction count. Pin runs a
+// REP-prefixed instruction's IPOINT_BEFORE call once per iteration, so
+// those keep their own call to count exactly what Instruction() counts.
+VOID Trace(TRACE trace, VOID *v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        UINT32 id = routineReport ? LookupRoutine(BBL_Address(bbl)) : NO_ROUTINE;
+        UINT32 numIns = BBL_NumIns(bbl);
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+            if (INS_HasRealRep(ins)) {
+                InsertCount(ins, 1, id);
+                numIns--;
+            }
+        }
+        if (numIns)
+            InsertCount(BBL_InsHead(bbl), numIns, id);
+    }
+}
+
+// Pin calls this function when a thread starts, before it runs any
+// analysis routine
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    assert(tid < MAX_THREADS);
+    PIN_GetLock(&chunkLock, tid + 1);
+    threadRoutines[tid].started = true;
+    AllocateChunks(tid, routines.size());
+    PIN_ReleaseLock(&chunkLock);
+}
+
+// Orders RoutineCount pointers by decreasing count
+int CompareRoutines(const void* a, const void* b)
+{
+    UINT64 ca = (*(RoutineCount* const*) a)->count;
+    UINT64 cb = (*(RoutineCount* const*) b)->count;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+// Writes the count of every image, then of every routine, each by
+// decreasing count, as "image,count" and "routine,image,count" lines
+VOID DumpRoutines(FILE* outFile)
+{
+    std::map<string, UINT64> imageCounts;
+    RoutineCount** sorted = new RoutineCount*[routines.size()];
+    UINT32 n = 0;
+    for (UINT32 id = 0; id < routines.size(); id++) {
+        for (UINT32 tid = 0; tid < MAX_THREADS; tid++) {
+            UINT64* chunk = threadRoutines[tid].chunks[id >> CHUNK_BITS];
+            if (chunk)
+                routines[id]->count += chunk[id & CHUNK_MASK];
+        }
+        imageCounts[routines[id]->image] += routines[id]->count;
+        sorted[n++] = routines[id];
+    }
+
+    std::map<string, RoutineCount> images;
+    RoutineCount** sortedImages = new RoutineCount*[imageCounts.size()];
+    UINT32 m = 0;
+    for (std::map<string, UINT64>::iterator it = imageCounts.begin(); it != imageCounts.end(); ++it) {
+        RoutineCount& image = images[it->first];
+        image.image = it->first;
+        image.count = it->second;
+        sortedImages[m++] = &image;
+    }
+
+    qsort(sortedImages, m, sizeof(RoutineCount*), CompareRoutines);
+    fprintf(outFile, "images\n");
+    for (UINT32 i = 0; i < m; i++)
+        fprintf(outFile, "%s,%lu\n", sortedImages[i]->image.c_str(), sortedImages[i]->count);
+
+    qsort(sorted, n, sizeof(RoutineCount*), CompareRoutines);
+    fprintf(outFile, "routines\n");
+    for (UINT32 i = 0; i < n; i++)
+        fprintf(outFile, "%s,%s,%lu\n", sorted[i]->name.c_str(), sorted[i]->image.c_str(), sorted[i]->count);
+
+    delete[] sortedImages;
+    delete[] sorted;
+}
+
 // This function is called when the application exits
 VOID Fini(INT32 code, VOID *v)
 {
+    for (UINT32 tid = 0; tid < MAX_THREADS; tid++)
+        icount += threadCounts[tid].count;
+
     FILE* outfile;
     assert(outfile = fopen(KnobOutputFile.Value().c_str(),"w"));
     fprintf(outfile, "Count: %lu\n", icount);
+
+    if (routineReport) {
+        FILE* rtnfile;
+        assert(rtnfile = fopen(KnobRoutineFile.Value().c_str(),"w"));
+        DumpRoutines(rtnfile);
+        fclose(rtnfile);
+    }
 }
 
 // argc, argv are the entire command line, including pin -t <toolname> -- ...
@@ -35,14 +241,30 @@ int main(int argc, char * argv[])
     // Initialize pin
     PIN_Init(argc, argv);
 
-    // Register Instruction to be called to instrument instructions
-    INS_AddInstrumentFunction(Instruction, 0);
+    routineReport = !KnobRoutineFile.Value().empty();
+    if (routineReport && !KnobBbl.Value()) {
+        fprintf(stderr, "inscount0: -rtn counts basic blocks, so it requires -bbl\n%s",
+                KNOB_BASE::StringKnobSummary().c_str());
+        return 1;
+    }
+    if (routineReport)
+        PIN_InitSymbols();
+    PIN_InitLock(&chunkLock);
+
+    if (KnobBbl.Value()) {
+        // Register Trace to be called to instrument whole traces
+        TRACE_AddInstrumentFunction(Trace, 0);
+        PIN_AddThreadStartFunction(ThreadStart, 0);
+    } else {
+        // Register Instruction to be called to instrument instructions
+        INS_AddInstrumentFunction(Instruction, 0);
+    }
 
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
-    
+
     // Start the program, never returns
     PIN_StartProgram();
-    
+
     return 0;
 }
@@ -0,0 +1,291 @@
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "pin.H"
+
+// Instruction mix: every instruction is counted by XED category, by
+// opcode, by number of memory operands and by the widest SIMD register it
+// names. The classification is done once per basic block at
+// instrumentation time and folded into a static vector of (counter,
+// instructions) pairs, so running a block costs one per-thread counter
+// add. Fini multiplies each block's vector by its execution count.
+
+// Layout of the counter space the static vectors index into
+static const UINT32 WIDTH_NONE = 0;
+static const UINT32 WIDTH_MMX = 1;
+static const UINT32 WIDTH_XMM = 2;
+static const UINT32 WIDTH_YMM = 3;
+static const UINT32 NUM_WIDTHS = 4;
+static const char* widthNames[NUM_WIDTHS] = { "none", "mmx", "xmm", "ymm" };
+static const UINT32 MAX_MEMOPS = 3;     // the last bucket counts 3 or more
+
+static const UINT32 CATEGORY_BASE = 0;
+static const UINT32 OPCODE_BASE = CATEGORY_BASE + XED_CATEGORY_LAST;
+static const UINT32 MEMOPS_BASE = OPCODE_BASE + XED_ICLASS_LAST;
+static const UINT32 MEMORY_READS = MEMOPS_BASE + MAX_MEMOPS + 1;
+static const UINT32 MEMORY_WRITES = MEMORY_READS + 1;
+static const UINT32 WIDTH_BASE = MEMORY_WRITES + 1;
+static const UINT32 NUM_COUNTERS = WIDTH_BASE + NUM_WIDTHS;
+
+// One entry of a block's static vector: counter gets n per execution
+struct MixEntry
+{
+    UINT32 counter;
+    UINT32 n;
+};
+
+// Static mix of one block, built when it is first instrumented
+struct BblMix
+{
+    UINT32 numIns;
+    std::vector<MixEntry> entries;
+};
+std::vector<BblMix*> bbls;                                  // indexed by block id
+std::map<std::pair<ADDRINT, UINT32>, UINT32> bblIds;        // (address, instructions) -> id
+
+// Every thread counts block executions into its own table, indexed by
+// block id, so threads only touch their own memory. The table is split
+// into chunks, allocated by ThreadStart for the ids handed out so far and
+// by LookupMix for every started thread when it hands out the first id of
+// a chunk, so a block never runs before its chunk exists. chunkLock keeps
+// the two from interleaving.
+static const UINT32 MAX_THREADS = 256;
+static const UINT32 CHUNK_BITS = 12;
+static const UINT32 CHUNK_MASK = (1u<<CHUNK_BITS) - 1;
+static const UINT32 MAX_CHUNKS = 1024;
+struct ThreadMix
+{
+    bool    started;
+    UINT64* chunks[MAX_CHUNKS];
+};
+ThreadMix threadMix[MAX_THREADS];
+PIN_LOCK chunkLock;
+
+// This knob will set the outfile name
+KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
+			    "o", "insmix.csv", "specify optional output file name");
+
+
+// This function is called before every basic block is executed
+VOID PIN_FAST_ANALYSIS_CALL docount(THREADID tid, UINT32 id)
+{
+    threadMix[tid].chunks[id >> CHUNK_BITS][id & CHUNK_MASK]++;
+}
+
+// Allocates the chunks of tid holding the ids below numIds; the caller
+// holds chunkLock
+VOID AllocateChunks(THREADID tid, UINT32 numIds)
+{
+    for (UINT32 c = 0; c < (numIds + CHUNK_MASK) >> CHUNK_BITS; c++)
+        if (!threadMix[tid].chunks[c])
+            threadMix[tid].chunks[c] = (UINT64*) calloc(CHUNK_MASK + 1, sizeof(UINT64));
+}
+
+// Returns the widest SIMD register read or written by ins
+UINT32 VectorWidth(INS ins)
+{
+    UINT32 width = WIDTH_NONE;
+    for (UINT32 i = 0; i < INS_MaxNumRRegs(ins) + INS_MaxNumWRegs(ins); i++) {
+        REG reg = i < INS_MaxNumRRegs(ins) ? INS_RegR(ins, i) : INS_RegW(ins, i - INS_MaxNumRRegs(ins));
+        if (REG_is_ymm(reg))
+            width = WIDTH_YMM;
+        else if (REG_is_xmm(reg) && width < WIDTH_XMM)
+            width = WIDTH_XMM;
+        else if (REG_is_mm(reg) && width < WIDTH_MMX)
+            width = WIDTH_MMX;
+    }
+    return width;
+}
+
+// Adds n to counter in a static vector under construction
+VOID AddToMix(UINT32* counts, UINT32 counter, UINT32 n)
+{
+    assert(counter < NUM_COUNTERS);
+    counts[counter] += n;
+}
+
+// Classifies ins into the counters of a static vector under construction
+VOID ClassifyIns(INS ins, UINT32* counts)
+{
+    AddToMix(counts, CATEGORY_BASE + INS_Category(ins), 1);
+    AddToMix(counts, OPCODE_BASE + INS_Opcode(ins), 1);
+
+    UINT32 memOps = INS_MemoryOperandCount(ins);
+    AddToMix(counts, MEMOPS_BASE + (memOps < MAX_MEMOPS ? memOps : MAX_MEMOPS), 1);
+    for (UINT32 i = 0; i < memOps; i++) {
+        if (INS_MemoryOperandIsRead(ins, i))
+            AddToMix(counts, MEMORY_READS, 1);
+        if (INS_MemoryOperandIsWritten(ins, i))
+            AddToMix(counts, MEMORY_WRITES, 1);
+    }
+
+    AddToMix(counts, WIDTH_BASE + VectorWidth(ins), 1);
+}
+
+// Returns the id of the static vector of the numIns instructions from
+// head, or of head alone if single is set, building it on first use.
+// A block at the same address with the same length has the same mix
+// whichever trace it was found in, so those share a vector and counters.
+UINT32 LookupMix(INS head, UINT32 numIns, bool single)
+{
+    std::pair<ADDRINT, UINT32> key(INS_Address(head), numIns);
+    std::map<std::pair<ADDRINT, UINT32>, UINT32>::iterator it = bblIds.find(key);
+    if (it != bblIds.end())
+        return it->second;
+
+    static UINT32 counts[NUM_COUNTERS];
+    for (INS ins = head; INS_Valid(ins); ins = single ? INS_Invalid() : INS_Next(ins))
+        if (single || !INS_HasRealRep(ins))
+            ClassifyIns(ins, counts);
+
+    BblMix* mix = new BblMix;
+    mix->numIns = 0;
+    for (UINT32 c = 0; c < NUM_COUNTERS; c++) {
+        if (!counts[c])
+            continue;
+        MixEntry entry = { c, counts[c] };
+        mix->entries.push_back(entry);
+        if (c >= CATEGORY_BASE && c < OPCODE_BASE)
+            mix->numIns += counts[c];
+        counts[c] = 0;
+    }
+
+    PIN_GetLock(&chunkLock, PIN_ThreadId() + 1);
+    UINT32 id = bbls.size();
+    assert((id >> CHUNK_BITS) < MAX_CHUNKS);
+    bbls.push_back(mix);
+    if ((id & CHUNK_MASK) == 0)
+        for (THREADID tid = 0; tid < MAX_THREADS; tid++)
+            if (threadMix[tid].started)
+                AllocateChunks(tid, id + 1);
+    PIN_ReleaseLock(&chunkLock);
+    bblIds[key] = id;
+    return id;
+}
+
+// Inserts one count of the static vector id before ins
+VOID InsertCount(INS ins, UINT32 id)
+{
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount, IARG_FAST_ANALYSIS_CALL,
+            IARG_THREAD_ID, IARG_UINT32, id, IARG_END);
+}
+
+// Pin calls this function every time a new trace is encountered. Each
+// block gets a single call counting its static vector. As in inscount0,
+// a REP-prefixed instruction runs its IPOINT_BEFORE call once per
+// iteration, so those keep a call and vector of their own.
+VOID Trace(TRACE trace, VOID *v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        UINT32 numIns = BBL_NumIns(bbl);
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+            if (INS_HasRealRep(ins)) {
+                InsertCount(ins, LookupMix(ins, 1, true));
+                numIns--;
+            }
+        }
+        if (numIns)
+            InsertCount(BBL_InsHead(bbl), LookupMix(BBL_InsHead(bbl), BBL_NumIns(bbl), false));
+    }
+}
+
+// Pin calls this function when a thread starts, before it runs any
+// analysis routine
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    assert(tid < MAX_THREADS);
+    PIN_GetLock(&chunkLock, tid + 1);
+    threadMix[tid].started = true;
+    AllocateChunks(tid, bbls.size());
+    PIN_ReleaseLock(&chunkLock);
+}
+
+// Totals of every counter, filled in by Fini
+UINT64 totals[NUM_COUNTERS];
+
+// Orders counter indices by decreasing total
+int CompareCounters(const void* a, const void* b)
+{
+    UINT64 ca = totals[*(const UINT32*) a];
+    UINT64 cb = totals[*(const UINT32*) b];
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+// Writes the nonzero counters in [base, base + n) by decreasing total, as
+// "name,count" lines under a header line
+VOID DumpSorted(FILE* outFile, const char* header, UINT32 base, UINT32 n, string (*name)(UINT32))
+{
+    UINT32* sorted = new UINT32[n];
+    UINT32 m = 0;
+    for (UINT32 i = 0; i < n; i++)
+        if (totals[base + i])
+            sorted[m++] = base + i;
+    qsort(sorted, m, sizeof(UINT32), CompareCounters);
+
+    fprintf(outFile, "%s\n", header);
+    for (UINT32 i = 0; i < m; i++)
+        fprintf(outFile, "%s,%lu\n", name(sorted[i] - base).c_str(), totals[sorted[i]]);
+    delete[] sorted;
+}
+
+string CategoryName(UINT32 category) { return CATEGORY_StringShort(category); }
+string OpcodeName(UINT32 opcode) { return OPCODE_StringShort(opcode); }
+
+// This function is called when the application exits
+VOID Fini(INT32 code, VOID *v)
+{
+    UINT64 icount = 0;
+    for (UINT32 id = 0; id < bbls.size(); id++) {
+        UINT64 execs = 0;
+        for (UINT32 tid = 0; tid < MAX_THREADS; tid++) {
+            UINT64* chunk = threadMix[tid].chunks[id >> CHUNK_BITS];
+            if (chunk)
+                execs += chunk[id & CHUNK_MASK];
+        }
+        for (UINT32 e = 0; e < bbls[id]->entries.size(); e++)
+            totals[bbls[id]->entries[e].counter] += execs * bbls[id]->entries[e].n;
+        icount += execs * bbls[id]->numIns;
+    }
+
+    FILE* outfile;
+    assert(outfile = fopen(KnobOutputFile.Value().c_str(),"w"));
+    fprintf(outfile, "instructions,%lu\n", icount);
+
+    DumpSorted(outfile, "categories", CATEGORY_BASE, XED_CATEGORY_LAST, CategoryName);
+    DumpSorted(outfile, "opcodes", OPCODE_BASE, XED_ICLASS_LAST, OpcodeName);
+
+    fprintf(outfile, "memory operands\n");
+    for (UINT32 i = 0; i <= MAX_MEMOPS; i++)
+        fprintf(outfile, "%u%s,%lu\n", i, i == MAX_MEMOPS ? "+" : "", totals[MEMOPS_BASE + i]);
+    fprintf(outfile, "memory reads,%lu\n", totals[MEMORY_READS]);
+    fprintf(outfile, "memory writes,%lu\n", totals[MEMORY_WRITES]);
+
+    fprintf(outfile, "vector width\n");
+    for (UINT32 i = 0; i < NUM_WIDTHS; i++)
+        fprintf(outfile, "%s,%lu\n", widthNames[i], totals[WIDTH_BASE + i]);
+    fclose(outfile);
+}
+
+// argc, argv are the entire command line, including pin -t <toolname> -- ...
+int main(int argc, char * argv[])
+{
+    // Initialize pin
+    PIN_Init(argc, argv);
+
+    PIN_InitLock(&chunkLock);
+
+    // Register Trace to be called to instrument whole traces
+    TRACE_AddInstrumentFunction(Trace, 0);
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+
+    // Register Fini to be called when the application exits
+    PIN_AddFiniFunction(Fini, 0);
+
+    // Start the program, never returns
+    PIN_StartProgram();
+
+    return 0;
+}
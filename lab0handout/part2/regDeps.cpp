@@ -3,14 +3,17 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdint.h>
-#include <algorithm>
-#include <vector>
 #include "pin.H"
+#include "reg_deps.h"
 
-// The array storing the spacing frequency between two dependant instructions
-UINT64 *dependencySpacing;
-
+// Declared by reg_deps.h
+ThreadDeps* threadDeps[MAX_THREADS];
 INT32 maxSize;
+bool ilp = false;
+bool memDeps = false;
+uint32_t window;
+uint64_t phaseLength;
+uint32_t shadowPages;
 
 // This knob sets the output file name
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "result.csv", "specify the output file name");
@@ -18,85 +21,32 @@ KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "result.csv", "
 // This knob will set the maximum spacing between two dependant instructions in the program
 KNOB<string> KnobMaxSpacing(KNOB_MODE_WRITEONCE, "pintool", "s", "100", "specify the maximum spacing between two dependant instructions in the program");
 
+// This knob will enable the dataflow-limit analysis and set its output file name
+KNOB<string> KnobIlpFile(KNOB_MODE_WRITEONCE, "pintool", "ilp", "", "specify file name for the dataflow-limit critical path and ILP report");
 
-// Convenience data structure
-typedef uint32_t reg_t;
-struct Registers {
-  std::vector<reg_t> read;
-  std::vector<reg_t> write;
-};
-
-
-// Global variables
-uint64_t instructionCounter = 0;
-uint64_t lastInstructionCount[1024];
-
-// This function is called before every instruction is executed. 
-// You have to edit this function to determine the dependency distance
-// and populate the dependencySpacing data structure.
-VOID updateDependencyDistanceInfo(void * vpParms) {
-  // Update the instruction counter
-  ++instructionCounter;
-
-  // regs contains the registers read and written by this instruction.
-  // regs->read contains the registers read.
-  // regs->write contains the registers written.
-  Registers * regs = (Registers*) vpParms;
+// This knob will set the reorder buffer size of the windowed dataflow machine
+KNOB<UINT32> KnobWindow(KNOB_MODE_WRITEONCE, "pintool", "w", "128", "specify the instruction window (ROB) size of the windowed dataflow machine");
 
-  std::vector<reg_t>::iterator it;
-  for (it = regs->read.begin(); it != regs->read.end(); ++it) {
-    reg_t reg = *it;
+// This knob will set the number of instructions in each reported phase
+KNOB<UINT64> KnobPhase(KNOB_MODE_WRITEONCE, "pintool", "phase", "100000000", "specify the number of instructions per dataflow-limit phase");
 
-    // Compute the dependency distance
-    uint64_t distance = instructionCounter - lastInstructionCount[reg];
+// This knob will enable the store-to-load dependency distance histogram
+KNOB<BOOL> KnobMemoryDeps(KNOB_MODE_WRITEONCE, "pintool", "mem", "0", "also count the spacing between a store and the loads reading it");
 
-    // Populate the dependencySpacing array
-    if (distance <= maxSize) {
-        // YOUR CODE HERE....
-        dependencySpacing[distance - 1]++;
-    }
-  }
-
-  for (it = regs->write.begin(); it != regs->write.end(); ++it) {
-    reg_t reg = *it;
-    // Update the lastInstructionCount for this register
-    lastInstructionCount[reg] = instructionCounter /**/;
-  }
-}
+// This knob will set how many pages of memory ready-times and stores each thread keeps
+KNOB<UINT32> KnobShadowPages(KNOB_MODE_WRITEONCE, "pintool", "shadow", "4096", "specify the number of pages in the shadow memory table (a power of two)");
 
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v)
 {
-  // regs stores the registers read, written by this instruction
-  Registers* regs = new Registers();
-
-  // Find all the registers read
-  for (uint32_t ir = 0; ir < INS_MaxNumRRegs(ins); ir++) {
-    REG rr = INS_RegR(ins, ir);
-    rr = REG_FullRegName(rr);
-    if (!REG_valid(rr)) {
-      continue;
-    }
-    if (std::find(regs->read.begin(), regs->read.end(), rr) == regs->read.end()) {
-      regs->read.push_back(rr);
-    }
-  }
-
-  // Find all the register written
-  for (uint32_t iw = 0; iw < INS_MaxNumWRegs(ins); iw++) {
-    REG wr = INS_RegW(ins, iw);
-    wr = REG_FullRegName(wr);
-    if (!REG_valid(wr)) {
-      continue;
-    }
-    if (std::find(regs->write.begin(), regs->write.end(), wr) == regs->write.end()) {
-      regs->write.push_back(wr);
-    }
-  }
+    instrumentRegDeps(ins);
+}
 
-  // Insert a call to the analysis function -- updateDependencyDistanceInfo -- before every instruction.
-  // Pass the regs structure to the analysis function.
-  INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)updateDependencyDistanceInfo, IARG_PTR, (void*)regs, IARG_END);
+// Pin calls this function when a thread starts, before it runs any
+// analysis routine
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    startRegDeps(tid);
 }
 
 // This function is called when the application exits
@@ -104,8 +54,14 @@ VOID Fini(INT32 code, VOID *v)
 {
     FILE* outfile;
     assert(outfile = fopen(KnobOutputFile.Value().c_str(),"w"));
-    for(INT32 i = 0; i < maxSize; i++)
-        fprintf(outfile, "%lu,", dependencySpacing[i]);
+    dumpDependencySpacing(outfile);
+
+    if (ilp) {
+        FILE* ilpfile;
+        assert(ilpfile = fopen(KnobIlpFile.Value().c_str(),"w"));
+        dumpDataflow(ilpfile);
+        fclose(ilpfile);
+    }
 }
 
 // argc, argv are the entire command line, including pin -t <toolname> -- ...
@@ -115,19 +71,26 @@ int main(int argc, char * argv[])
     PIN_Init(argc, argv);
 
     maxSize = atoi(KnobMaxSpacing.Value().c_str());
+    assert(maxSize > 0);
+
+    ilp = !KnobIlpFile.Value().empty();
+    memDeps = KnobMemoryDeps.Value();
+    window = KnobWindow.Value();
+    phaseLength = KnobPhase.Value();
+    shadowPages = KnobShadowPages.Value();
+    assert(window > 0 && phaseLength > 0);
 
-    // Initializing depdendancy Spacing
-    dependencySpacing = new UINT64[maxSize];
+    // Per-thread tables and histograms are set up as threads start
+    PIN_AddThreadStartFunction(ThreadStart, 0);
 
     // Register Instruction to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
 
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
-    
+
     // Start the program, never returns
     PIN_StartProgram();
-    
+
     return 0;
 }
-
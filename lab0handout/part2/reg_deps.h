@@ -0,0 +1,492 @@
+#ifndef REG_DEPS_H
+#define REG_DEPS_H
+
+// Register and memory dependency analyses of regDeps, kept apart from its
+// knobs and main so other tools can run them in the same Pin instance.
+// The including file includes pin.H, defines and sets the parameters below,
+// and calls instrumentRegDeps() for every instruction and
+// startRegDeps() as every thread starts.
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Registers read or written by an instruction, packed into one word at
+// instrumentation time so the analysis routine gets them by value:
+//
+//   bits 0-2   number of registers, at most REGS_PER_LIST
+//   bit  3     set on the first list of an instruction, which counts it
+//   bits 4-63  register numbers, REG_BITS each
+//
+// Instructions touching more registers get several lists, the first
+// carrying the flag and the writes coming after all the reads.
+typedef uint64_t reg_list_t;
+static const uint32_t REG_BITS = 10;
+static const uint32_t NUM_REGS = 1u << REG_BITS;
+static const uint32_t REGS_PER_LIST = 6;
+static const reg_list_t LIST_NEW_INSTRUCTION = 1u << 3;
+// Set on the write list of an instruction's last call, under -ilp
+static const reg_list_t LIST_LAST_CALL = 1u << 3;
+
+inline uint32_t listCount(reg_list_t list) { return list & 7; }
+inline reg_list_t listRegs(reg_list_t list) { return list >> 4; }
+
+// The dataflow-limit analysis (-ilp) runs every thread's instructions on
+// two idealized machines with perfect branch prediction, unlimited
+// functional units and a latency of one cycle: one unbounded, and one
+// that only issues an instruction once the one KnobWindow before it has
+// retired in order. An instruction issues when its register and memory
+// sources are ready, so the cycles each machine needs are the critical
+// path of the dataflow graph and instructions / cycles the ILP it allows.
+enum Machine { MACHINE_UNBOUNDED, MACHINE_WINDOWED, NUM_MACHINES };
+static const char* machineNames[NUM_MACHINES] = { "unbounded", "windowed" };
+
+// Per 8 byte word of memory, the cycle at which the last value stored to
+// it is ready on each machine (-ilp) and the instruction that stored it
+// (-mem). Pages are found through a direct-mapped, hashed table of a
+// fixed number of slots, so memory stays bounded however large the
+// footprint: a page taking over a slot starts out with every word ready
+// at cycle 0 and never stored.
+static const uint32_t LOG_SHADOW_PAGE = 12;
+static const uint32_t LOG_SHADOW_WORD = 3;
+static const uint32_t SHADOW_WORDS = 1u << (LOG_SHADOW_PAGE - LOG_SHADOW_WORD);
+
+class ShadowMemory
+{
+  public:
+    struct Word {
+      uint64_t ready[NUM_MACHINES];
+      uint64_t lastStore;   // instructionCounter of the last store, 0 for none
+    };
+
+  private:
+    struct Page {
+      ADDRINT pageNumber;
+      Word words[SHADOW_WORDS];
+    };
+
+    Page** pages;
+    uint32_t mask;
+
+  public:
+    uint64_t evictions;
+
+    ShadowMemory(uint32_t numPages) {
+      assert(numPages && !(numPages & (numPages - 1)));
+      pages = new Page*[numPages]();
+      mask = numPages - 1;
+      evictions = 0;
+    }
+    ~ShadowMemory() {
+      for (uint32_t i = 0; i <= mask; i++)
+        delete pages[i];
+      delete[] pages;
+    }
+
+    Word* lookup(ADDRINT addr) {
+      ADDRINT pageNumber = addr >> LOG_SHADOW_PAGE;
+      Page*& p = pages[(uint32_t) ((pageNumber * 0x9E3779B97F4A7C15ull) >> 40) & mask];
+      if (!p) {
+        p = new Page();
+        p->pageNumber = pageNumber;
+      } else if (p->pageNumber != pageNumber) {
+        memset(p->words, 0, sizeof(p->words));
+        p->pageNumber = pageNumber;
+        evictions++;
+      }
+      return &p->words[(addr >> LOG_SHADOW_WORD) & (SHADOW_WORDS - 1)];
+    }
+};
+
+// Instructions and cycles of one phase of a thread on both machines
+struct Phase
+{
+  uint64_t instructions;
+  uint64_t cycles[NUM_MACHINES];
+};
+
+// Per-thread state, indexed by THREADID. A register whose last write is 0
+// has not been written by this thread yet.
+static const uint32_t MAX_THREADS = 256;
+static const uint32_t MAX_PENDING_WRITES = 16;
+struct ThreadDeps
+{
+  uint64_t instructionCounter;
+  uint64_t lastInstructionCount[NUM_REGS];
+  UINT64*  dependencySpacing;   // maxSize + 1 buckets
+  UINT64*  memorySpacing;       // the same for store to load, with -mem
+  ShadowMemory* memory;         // with -ilp or -mem
+
+  // Dataflow-limit state, used with -ilp
+  uint64_t regReady[NUM_MACHINES][NUM_REGS];
+  uint64_t sourceReady[NUM_MACHINES];   // of the instruction being issued
+  reg_list_t pendingWrites[MAX_PENDING_WRITES];
+  uint32_t numPendingWrites;
+  uint64_t* retired;                    // ring of the last KnobWindow retire cycles
+  uint64_t lastRetired;
+  uint64_t criticalPath;                // latest completion on the unbounded machine
+  Phase phaseStart;
+  std::vector<Phase> phases;
+};
+
+// The analysis state is defined once by the including tool, next to its
+// main(), which sets the parameters from its knobs before any thread starts
+extern ThreadDeps* threadDeps[MAX_THREADS];
+extern INT32 maxSize;              // spacings beyond are counted in the overflow bucket
+extern bool ilp;
+extern bool memDeps;
+extern uint32_t window;
+extern uint64_t phaseLength;
+extern uint32_t shadowPages;
+
+
+// Counts the dependency distance of a read of reg in dependencySpacing
+inline VOID countDistance(ThreadDeps* t, uint32_t reg) {
+  uint64_t last = t->lastInstructionCount[reg];
+
+  // Compute the dependency distance
+  uint64_t distance = t->instructionCounter - last;
+
+  // Populate the dependencySpacing array
+  if (distance <= (uint64_t) maxSize)
+    t->dependencySpacing[distance - 1]++;
+  else if (last)
+    t->dependencySpacing[maxSize]++;
+}
+
+// This function is called before every instruction is executed, once per
+// pair of read and write lists, to determine the dependency distance and
+// populate the dependencySpacing data structure.
+inline VOID PIN_FAST_ANALYSIS_CALL updateDependencyDistanceInfo(THREADID tid, ADDRINT read, ADDRINT write) {
+  ThreadDeps* t = threadDeps[tid];
+
+  // Update the instruction counter
+  if (read & LIST_NEW_INSTRUCTION)
+    ++t->instructionCounter;
+
+  reg_list_t regs = listRegs(read);
+  for (uint32_t i = listCount(read); i > 0; i--, regs >>= REG_BITS)
+    countDistance(t, regs & (NUM_REGS - 1));
+
+  // Update the lastInstructionCount for the registers written
+  regs = listRegs(write);
+  for (uint32_t i = listCount(write); i > 0; i--, regs >>= REG_BITS)
+    t->lastInstructionCount[regs & (NUM_REGS - 1)] = t->instructionCounter;
+}
+
+// Closes the current phase of t
+inline VOID endPhase(ThreadDeps* t) {
+  Phase end;
+  end.instructions = t->instructionCounter;
+  end.cycles[MACHINE_UNBOUNDED] = t->criticalPath;
+  end.cycles[MACHINE_WINDOWED] = t->lastRetired;
+  Phase p;
+  p.instructions = end.instructions - t->phaseStart.instructions;
+  for (uint32_t m = 0; m < NUM_MACHINES; m++)
+    p.cycles[m] = end.cycles[m] - t->phaseStart.cycles[m];
+  t->phases.push_back(p);
+  t->phaseStart = end;
+}
+
+// Issues the current instruction on both machines once all its sources
+// are known, then makes its register and memory results ready
+inline VOID issue(ThreadDeps* t, ADDRINT writeEa, UINT32 writeSize) {
+  uint64_t complete[NUM_MACHINES];
+  complete[MACHINE_UNBOUNDED] = t->sourceReady[MACHINE_UNBOUNDED] + 1;
+  if (complete[MACHINE_UNBOUNDED] > t->criticalPath)
+    t->criticalPath = complete[MACHINE_UNBOUNDED];
+
+  // The slot of this instruction holds the retire cycle of the one window
+  // instructions before it
+  uint64_t& slot = t->retired[t->instructionCounter % window];
+  complete[MACHINE_WINDOWED] = std::max(t->sourceReady[MACHINE_WINDOWED], slot) + 1;
+  t->lastRetired = std::max(t->lastRetired, complete[MACHINE_WINDOWED]);
+  slot = t->lastRetired;
+
+  for (uint32_t w = 0; w < t->numPendingWrites; w++) {
+    reg_list_t regs = listRegs(t->pendingWrites[w]);
+    for (uint32_t i = listCount(t->pendingWrites[w]); i > 0; i--, regs >>= REG_BITS)
+      for (uint32_t m = 0; m < NUM_MACHINES; m++)
+        t->regReady[m][regs & (NUM_REGS - 1)] = complete[m];
+  }
+  t->numPendingWrites = 0;
+
+  if (writeSize) {
+    for (ADDRINT a = writeEa >> LOG_SHADOW_WORD; a <= (writeEa + writeSize - 1) >> LOG_SHADOW_WORD; a++) {
+      ShadowMemory::Word* word = t->memory->lookup(a << LOG_SHADOW_WORD);
+      for (uint32_t m = 0; m < NUM_MACHINES; m++)
+        word->ready[m] = complete[m];
+    }
+  }
+
+  for (uint32_t m = 0; m < NUM_MACHINES; m++)
+    t->sourceReady[m] = 0;
+  if (t->instructionCounter % phaseLength == 0)
+    endPhase(t);
+}
+
+// Accumulates the ready cycles of the size bytes read at ea
+inline VOID readMemory(ThreadDeps* t, ADDRINT ea, UINT32 size) {
+  for (ADDRINT a = ea >> LOG_SHADOW_WORD; a <= (ea + size - 1) >> LOG_SHADOW_WORD; a++) {
+    ShadowMemory::Word* word = t->memory->lookup(a << LOG_SHADOW_WORD);
+    for (uint32_t m = 0; m < NUM_MACHINES; m++)
+      t->sourceReady[m] = std::max(t->sourceReady[m], word->ready[m]);
+  }
+}
+
+// Counts the spacing between the load of size bytes at ea and the latest
+// store to any of its words in memorySpacing
+inline VOID countMemoryDistance(ThreadDeps* t, ADDRINT ea, UINT32 size) {
+  uint64_t last = 0;
+  for (ADDRINT a = ea >> LOG_SHADOW_WORD; a <= (ea + size - 1) >> LOG_SHADOW_WORD; a++)
+    last = std::max(last, t->memory->lookup(a << LOG_SHADOW_WORD)->lastStore);
+  if (!last)
+    return;
+  uint64_t distance = t->instructionCounter - last;
+  if (distance <= (uint64_t) maxSize)
+    t->memorySpacing[distance - 1]++;
+  else
+    t->memorySpacing[maxSize]++;
+}
+
+// Counts the memory dependencies of the current instruction, then makes
+// it the last store to the words it writes. A load reading a word its own
+// instruction writes depends on the previous store.
+inline VOID updateMemoryDeps(ThreadDeps* t, ADDRINT readEa, ADDRINT read2Ea, UINT32 readSize,
+                             ADDRINT writeEa, UINT32 writeSize) {
+  if (readSize) {
+    countMemoryDistance(t, readEa, readSize);
+    if (read2Ea)
+      countMemoryDistance(t, read2Ea, readSize);
+  }
+  if (writeSize)
+    for (ADDRINT a = writeEa >> LOG_SHADOW_WORD; a <= (writeEa + writeSize - 1) >> LOG_SHADOW_WORD; a++)
+      t->memory->lookup(a << LOG_SHADOW_WORD)->lastStore = t->instructionCounter;
+}
+
+// With -mem and without -ilp this function is called before every memory
+// instruction, after updateDependencyDistanceInfo
+inline VOID PIN_FAST_ANALYSIS_CALL updateMemoryDependencyInfo(THREADID tid, ADDRINT readEa, ADDRINT read2Ea, UINT32 readSize,
+                                                       ADDRINT writeEa, UINT32 writeSize) {
+  updateMemoryDeps(threadDeps[tid], readEa, read2Ea, readSize, writeEa, writeSize);
+}
+
+// With -ilp this function replaces updateDependencyDistanceInfo. It also
+// collects the ready cycles of the sources, and the last call of each
+// instruction, which gets its memory operands, issues it.
+inline VOID PIN_FAST_ANALYSIS_CALL updateDataflow(THREADID tid, ADDRINT read, ADDRINT write,
+                                           ADDRINT readEa, ADDRINT read2Ea, UINT32 readSize,
+                                           ADDRINT writeEa, UINT32 writeSize) {
+  ThreadDeps* t = threadDeps[tid];
+  if (read & LIST_NEW_INSTRUCTION)
+    ++t->instructionCounter;
+
+  reg_list_t regs = listRegs(read);
+  for (uint32_t i = listCount(read); i > 0; i--, regs >>= REG_BITS) {
+    uint32_t reg = regs & (NUM_REGS - 1);
+    countDistance(t, reg);
+    for (uint32_t m = 0; m < NUM_MACHINES; m++)
+      t->sourceReady[m] = std::max(t->sourceReady[m], t->regReady[m][reg]);
+  }
+
+  regs = listRegs(write);
+  for (uint32_t i = listCount(write); i > 0; i--, regs >>= REG_BITS)
+    t->lastInstructionCount[regs & (NUM_REGS - 1)] = t->instructionCounter;
+  if (listCount(write))
+    t->pendingWrites[t->numPendingWrites++] = write;
+
+  if (write & LIST_LAST_CALL) {
+    if (memDeps)
+      updateMemoryDeps(t, readEa, read2Ea, readSize, writeEa, writeSize);
+    if (readSize) {
+      readMemory(t, readEa, readSize);
+      if (read2Ea)
+        readMemory(t, read2Ea, readSize);
+    }
+    issue(t, writeEa, writeSize);
+  }
+}
+
+// Appends reg to the lists in lists, starting a new list when the last is
+// full, unless it is already present
+inline VOID addReg(reg_list_t* lists, uint32_t* numLists, REG reg) {
+  assert(reg < NUM_REGS);
+  for (uint32_t l = 0; l < *numLists; l++) {
+    reg_list_t regs = listRegs(lists[l]);
+    for (uint32_t i = listCount(lists[l]); i > 0; i--, regs >>= REG_BITS)
+      if ((regs & (NUM_REGS - 1)) == reg)
+        return;
+  }
+  if (*numLists == 0 || listCount(lists[*numLists - 1]) == REGS_PER_LIST)
+    lists[(*numLists)++] = 0;
+  reg_list_t& list = lists[*numLists - 1];
+  list |= (reg_list_t) reg << (4 + REG_BITS * listCount(list));
+  list++;
+}
+
+// Adds the memory operands of ins to args as readEa, read2Ea, readSize,
+// writeEa and writeSize, passing 0 for the ones it does not have
+inline VOID addMemoryArgs(IARGLIST args, INS ins)
+{
+  if (INS_IsMemoryRead(ins)) {
+    IARGLIST_AddArguments(args, IARG_MEMORYREAD_EA, IARG_END);
+    if (INS_HasMemoryRead2(ins))
+      IARGLIST_AddArguments(args, IARG_MEMORYREAD2_EA, IARG_END);
+    else
+      IARGLIST_AddArguments(args, IARG_ADDRINT, (ADDRINT) 0, IARG_END);
+    IARGLIST_AddArguments(args, IARG_MEMORYREAD_SIZE, IARG_END);
+  } else
+    IARGLIST_AddArguments(args, IARG_ADDRINT, (ADDRINT) 0, IARG_ADDRINT, (ADDRINT) 0, IARG_UINT32, 0, IARG_END);
+  if (INS_IsMemoryWrite(ins))
+    IARGLIST_AddArguments(args, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_END);
+  else
+    IARGLIST_AddArguments(args, IARG_ADDRINT, (ADDRINT) 0, IARG_UINT32, 0, IARG_END);
+}
+
+// Inserts the register (and, with memDeps, memory) dependency analysis
+// of ins, or with ilp the dataflow-limit analysis
+inline VOID instrumentRegDeps(INS ins)
+{
+  // Lists of the registers read and written by this instruction
+  static const uint32_t MAX_LISTS = NUM_REGS / REGS_PER_LIST + 1;
+  reg_list_t read[MAX_LISTS], write[MAX_LISTS];
+  uint32_t numRead = 0, numWrite = 0;
+
+  // Find all the registers read
+  for (uint32_t ir = 0; ir < INS_MaxNumRRegs(ins); ir++) {
+    REG rr = REG_FullRegName(INS_RegR(ins, ir));
+    if (REG_valid(rr))
+      addReg(read, &numRead, rr);
+  }
+
+  // Find all the register written
+  for (uint32_t iw = 0; iw < INS_MaxNumWRegs(ins); iw++) {
+    REG wr = REG_FullRegName(INS_RegW(ins, iw));
+    if (REG_valid(wr))
+      addReg(write, &numWrite, wr);
+  }
+  assert(numWrite <= MAX_PENDING_WRITES);
+
+  // Insert calls to the analysis function -- updateDependencyDistanceInfo -- before every
+  // instruction, pass the lists by value. The last read list shares its call with the
+  // first write list, so most instructions need a single call.
+  uint32_t firstWrite = numRead ? numRead - 1 : 0;
+  uint32_t numCalls = std::max(firstWrite + numWrite, numRead);
+  for (uint32_t c = 0; c < std::max(numCalls, 1u); c++) {
+    reg_list_t r = c < numRead ? read[c] : 0;
+    reg_list_t w = c >= firstWrite && c - firstWrite < numWrite ? write[c - firstWrite] : 0;
+    if (c == 0)
+      r |= LIST_NEW_INSTRUCTION;
+    if (!ilp) {
+      INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)updateDependencyDistanceInfo, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, (ADDRINT) r, IARG_ADDRINT, (ADDRINT) w, IARG_END);
+      continue;
+    }
+    if (c + 1 < std::max(numCalls, 1u)) {
+      INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)updateDataflow, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, (ADDRINT) r, IARG_ADDRINT, (ADDRINT) w,
+                     IARG_ADDRINT, (ADDRINT) 0, IARG_ADDRINT, (ADDRINT) 0, IARG_UINT32, 0,
+                     IARG_ADDRINT, (ADDRINT) 0, IARG_UINT32, 0, IARG_END);
+      continue;
+    }
+
+    // The last call also passes the memory operands
+    w |= LIST_LAST_CALL;
+    IARGLIST args = IARGLIST_Alloc();
+    addMemoryArgs(args, ins);
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)updateDataflow, IARG_FAST_ANALYSIS_CALL,
+                   IARG_THREAD_ID, IARG_ADDRINT, (ADDRINT) r, IARG_ADDRINT, (ADDRINT) w,
+                   IARG_IARGLIST, args, IARG_END);
+    IARGLIST_Free(args);
+  }
+
+  // Without -ilp the memory dependencies get a call of their own
+  if (memDeps && !ilp && (INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins))) {
+    IARGLIST args = IARGLIST_Alloc();
+    addMemoryArgs(args, ins);
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)updateMemoryDependencyInfo, IARG_FAST_ANALYSIS_CALL,
+                   IARG_THREAD_ID, IARG_IARGLIST, args, IARG_END);
+    IARGLIST_Free(args);
+  }
+}
+
+// Sets up the tables and histograms of thread tid, before it runs any
+// analysis routine
+inline VOID startRegDeps(THREADID tid)
+{
+  assert(tid < MAX_THREADS);
+  ThreadDeps* t = new ThreadDeps();
+  t->dependencySpacing = new UINT64[maxSize + 1]();
+  if (ilp)
+    t->retired = new uint64_t[window]();
+  if (ilp || memDeps)
+    t->memory = new ShadowMemory(shadowPages);
+  if (memDeps)
+    t->memorySpacing = new UINT64[maxSize + 1]();
+  threadDeps[tid] = t;
+}
+
+// Writes one line per phase of every thread, then each thread's totals, as
+// "thread,phase,instructions,<machine> cycles,<machine> ilp,..."
+inline VOID dumpDataflow(FILE* outFile)
+{
+    fprintf(outFile, "thread,phase,instructions");
+    for (UINT32 m = 0; m < NUM_MACHINES; m++)
+        fprintf(outFile, ",%s cycles,%s ilp", machineNames[m], machineNames[m]);
+    fprintf(outFile, "\n");
+    for (UINT32 tid = 0; tid < MAX_THREADS; tid++) {
+        ThreadDeps* t = threadDeps[tid];
+        if (!t)
+            continue;
+        if (t->instructionCounter > t->phaseStart.instructions)
+            endPhase(t);
+        Phase total = { 0, { 0 } };
+        for (UINT32 i = 0; i <= t->phases.size(); i++) {
+            const Phase& p = i < t->phases.size() ? t->phases[i] : total;
+            if (i < t->phases.size())
+                fprintf(outFile, "%u,%u,%lu", tid, i, p.instructions);
+            else
+                fprintf(outFile, "%u,total,%lu", tid, p.instructions);
+            for (UINT32 m = 0; m < NUM_MACHINES; m++)
+                fprintf(outFile, ",%lu,%f", p.cycles[m], p.cycles[m] ? (double) p.instructions / p.cycles[m] : 0.0);
+            fprintf(outFile, "\n");
+            total.instructions += p.instructions;
+            for (UINT32 m = 0; m < NUM_MACHINES; m++)
+                total.cycles[m] += p.cycles[m];
+        }
+        fprintf(outFile, "%u,shadow evictions,%lu\n", tid, t->memory->evictions);
+    }
+}
+
+// Writes the summed dependencySpacing histogram as one line of maxSize
+// counts and an overflow line, then the memorySpacing one with -mem
+inline VOID dumpDependencySpacing(FILE* outFile)
+{
+    // Sum the per-thread histograms
+    UINT64* dependencySpacing = new UINT64[maxSize + 1]();
+    UINT64* memorySpacing = new UINT64[maxSize + 1]();
+    for (UINT32 tid = 0; tid < MAX_THREADS; tid++) {
+        for (INT32 i = 0; threadDeps[tid] && i <= maxSize; i++) {
+            dependencySpacing[i] += threadDeps[tid]->dependencySpacing[i];
+            if (memDeps)
+                memorySpacing[i] += threadDeps[tid]->memorySpacing[i];
+        }
+    }
+
+    for(INT32 i = 0; i < maxSize; i++)
+        fprintf(outFile, "%lu,", dependencySpacing[i]);
+    fprintf(outFile, "\noverflow,%lu\n", dependencySpacing[maxSize]);
+    if (memDeps) {
+        // The store-to-load histogram follows in the same layout
+        fprintf(outFile, "memory,");
+        for(INT32 i = 0; i < maxSize; i++)
+            fprintf(outFile, "%lu,", memorySpacing[i]);
+        fprintf(outFile, "\nmemory overflow,%lu\n", memorySpacing[maxSize]);
+    }
+    delete[] dependencySpacing;
+    delete[] memorySpacing;
+}
+
+#endif
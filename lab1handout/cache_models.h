@@ -0,0 +1,1695 @@
+#ifndef CACHE_MODELS_H
+#define CACHE_MODELS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "cache_types.h"
+#include "cache_policies.h"
+
+#define CACHE_DEBUG 0
+
+// Defined once by the tool, in the file with its main(), and set before
+// it builds any model
+extern UINT32 logPageSize;
+extern UINT32 logPhysicalMemSize;
+
+//Function to obtain physical page number given a virtual page number
+inline UINT32 getPhysicalPageNumber(UINT32 virtualPageNumber)
+{
+    INT32 key = (INT32) virtualPageNumber;
+    key = ~key + (key << 15); // key = (key << 15) - key - 1;
+    key = key ^ (key >> 12);
+    key = key + (key << 2);
+    key = key ^ (key >> 4);
+    key = key * 2057; // key = (key + (key << 3)) + (key << 11);
+    key = key ^ (key >> 16);
+    return (UINT32) (key&(((UINT32)(~0))>>(32-(logPhysicalMemSize-logPageSize))));
+}
+
+//Function to obtain the physical address of a virtual address
+inline UINT32 getPhysicalAddr(UINT32 virtualAddr)
+{
+    return (getPhysicalPageNumber(virtualAddr >> logPageSize) << logPageSize) | (virtualAddr & ((1u<<logPageSize)-1));
+}
+
+// Direct-mapped memo of recent getPhysicalPageNumber() results, so the
+// models sharing it translate each page once per reference and recompute
+// the hash only when the page changes
+static const UINT32 TRANSLATION_MEMO_ENTRIES = 1024;
+
+class TranslationMemo
+{
+        struct Entry {
+            UINT32 virtualPageNumber;   // ~0 when empty
+            UINT32 physicalPageNumber;
+        };
+        Entry entries[TRANSLATION_MEMO_ENTRIES];
+        UINT32 asid;
+        UINT32 sharedPercent;
+
+    public:
+        TranslationMemo() : asid(0), sharedPercent(0)
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (UINT32 i = 0; i < TRANSLATION_MEMO_ENTRIES; i++)
+                entries[i].virtualPageNumber = ~0u;
+        }
+
+        // Every address space but ASID 0 gets its own physical pages, except
+        // for the sharedPercent of virtual pages mapped alike in all of them
+        void setAsid(UINT32 asidParam, UINT32 sharedPercentParam)
+        {
+            asid = asidParam;
+            sharedPercent = sharedPercentParam;
+            clear();
+        }
+
+        UINT32 getPhysicalAddr(UINT32 virtualAddr)
+        {
+            UINT32 vpn = virtualAddr >> logPageSize;
+            Entry& e = entries[vpn & (TRANSLATION_MEMO_ENTRIES - 1)];
+            if (e.virtualPageNumber != vpn) {
+                UINT32 key = vpn;
+                if (asid && (vpn * 2654435761u >> 16) % 100 >= sharedPercent)
+                    key |= asid << (32 - logPageSize);
+                e.virtualPageNumber = vpn;
+                e.physicalPageNumber = getPhysicalPageNumber(key);
+            }
+            return (e.physicalPageNumber << logPageSize) | (virtualAddr & ((1u<<logPageSize)-1));
+        }
+};
+
+// Tag value of an empty way. Addresses reaching the models are word
+// aligned, so no real tag can be all ones.
+static const UINT32 INVALID_TAG = ~0u;
+
+// Ways are searched 4 (SSE2) or 8 (AVX2) at a time
+static const UINT32 TAG_VECTOR_WAYS = 4;
+
+// Row i holds its tags at tag[i * tagStride]. The stride is the
+// associativity rounded up to a power of two (at least TAG_VECTOR_WAYS
+// unless direct-mapped) so a row never straddles a host cache line;
+// padding ways hold INVALID_TAG.
+inline UINT32 tagStrideFor(UINT32 associativity)
+{
+    UINT32 stride = 1;
+    while (stride < associativity)
+        stride <<= 1;
+    return stride > 1 && stride < TAG_VECTOR_WAYS ? TAG_VECTOR_WAYS : stride;
+}
+
+// Set-associative tag store shared by the three lab1 models. Policy is one
+// of the recency structures in cache_policies.h and A the associativity
+// when it is known at compile time (0 otherwise), so each specialization
+// inlines its lookup and replacement with no virtual calls.
+template <template <UINT32> class Policy, UINT32 A>
+class CacheModel
+{
+    protected:
+        UINT32   logNumRows;
+        UINT32   logBlockSize;
+        UINT32   associativity;
+        UINT64   readReqs;
+        UINT64   writeReqs;
+        UINT64   readHits;
+        UINT64   writeHits;
+        UINT32   tagShift;  // logBlockSize + logNumRows
+        UINT32   rowMask;   // (1 << logNumRows) - 1
+        UINT32   tagStride;
+        UINT32*  tag;
+        UINT8*   tagAlloc;
+        Policy<A> lru;
+
+        UINT32 ways() const { return A ? A : associativity; }
+        UINT32 stride() const { return A ? (A == 1 ? 1 : (A < TAG_VECTOR_WAYS ? TAG_VECTOR_WAYS : A)) : tagStride; }
+
+    public:
+        //Constructor for a cache
+        CacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
+            : lru(1u<<logNumRowsParam, associativityParam)
+        {
+            assert (A == 0 || A == associativityParam);
+            logNumRows = logNumRowsParam;
+            logBlockSize = logBlockSizeParam;
+            associativity = associativityParam;
+            readReqs = 0;
+            writeReqs = 0;
+            readHits = 0;
+            writeHits = 0;
+            tagShift = logBlockSize + logNumRows;
+            rowMask = (1u<<logNumRows)-1;
+            tagStride = tagStrideFor(associativity);
+            size_t numTags = (size_t) tagStride << logNumRows;
+            tag = alignedArray<UINT32>(numTags, &tagAlloc);
+            for(size_t i = 0; i < numTags; i++)
+                tag[i] = INVALID_TAG;
+            PolicyBlockSize<Policy<A> >::set(lru, logBlockSize);
+        }
+        // Destructor
+        ~CacheModel()
+        {
+            delete[] tagAlloc;
+        }
+
+        bool searchAddr(UINT32 addr, UINT32* r_j) {
+            return searchTag(getTag(addr), getIdx(addr), r_j);
+        }
+
+        bool searchTag(UINT32 x_tag, UINT32 x_idx, UINT32* r_j) {
+            const UINT32* row = tag + (size_t) x_idx * stride();
+#if defined(__AVX2__)
+            if (stride() >= 8) {
+                __m256i needle = _mm256_set1_epi32((int) x_tag);
+                for (UINT32 j = 0; j < stride(); j += 8) {
+                    __m256i ways = _mm256_load_si256((const __m256i*) (row + j));
+                    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(ways, needle)));
+                    if (mask) {
+                        *r_j = j + __builtin_ctz(mask); return true;
+                    }
+                }
+                return false;
+            }
+#endif
+#if defined(__SSE2__)
+            if (stride() >= 4) {
+                __m128i needle = _mm_set1_epi32((int) x_tag);
+                for (UINT32 j = 0; j < stride(); j += 4) {
+                    __m128i ways = _mm_load_si128((const __m128i*) (row + j));
+                    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ways, needle)));
+                    if (mask) {
+                        *r_j = j + __builtin_ctz(mask); return true;
+                    }
+                }
+                return false;
+            }
+#endif
+            for(UINT32 j = 0; j < ways(); j++) {
+                if (row[j] == x_tag) {
+                    *r_j = j; return true;
+                }
+            }
+            return false;
+        }
+
+        // Empties every way, as on a context switch without ASIDs
+        void flush() {
+            for (size_t i = 0; i < ((size_t) stride() << logNumRows); i++)
+                tag[i] = INVALID_TAG;
+        }
+
+        // Installs x_tag in way x_j of row idx
+        void fill(UINT32 idx, UINT32 x_j, UINT32 x_tag) {
+            assert (x_tag != INVALID_TAG);
+            tag[(size_t) idx * stride() + x_j] = x_tag;
+        }
+
+        UINT32 getPageNumber(UINT32 addr) {
+            return addr >> logPageSize;
+        }
+        UINT32 getPageOffset(UINT32 addr) {
+            return addr & ((1u<<logPageSize)-1);
+        }
+        UINT32 getTag(UINT32 addr) {
+            return addr >> tagShift;
+        }
+        UINT32 getIdx(UINT32 addr) {
+            return (addr >> logBlockSize) & rowMask;
+        }
+        UINT32 getOffset(UINT32 addr) {
+            return addr & ((1u<<logBlockSize)-1);
+        }
+
+        // Make address from tag, idx and offset
+        UINT32 makeAddr(UINT32 tag, UINT32 idx, UINT32 offset) {
+            assert (idx < (1u<<logNumRows));
+            assert (offset < (1u<<logBlockSize));
+
+            return (tag << tagShift) | (idx << logBlockSize) | offset;
+        }
+        // Make address from ppn and offset
+        UINT32 makeAddr(UINT32 pageNumber, UINT32 pageOffset) {
+            assert (pageOffset < (1u<<logPageSize));
+
+            return (pageNumber << logPageSize) | pageOffset;
+        }
+
+        // Marks way x_j of row idx as the most recently used
+        void lruTouch(UINT32 idx, UINT32 x_j) {
+            assert (idx < (1u<<logNumRows));
+            assert (x_j < ways());
+            lru.touch(idx, x_j);
+        }
+        // Tells the policy way x_j of row idx was just filled
+        void lruFill(UINT32 idx, UINT32 x_j) {
+            assert (idx < (1u<<logNumRows));
+            assert (x_j < ways());
+            lru.insert(idx, x_j);
+        }
+        // Returns the way of row idx to replace next
+        UINT32 lruHead(UINT32 idx) {
+            return lru.victim(idx);
+        }
+
+        // Adds the counters of another model of the same geometry, e.g. one
+        // simulating a different thread
+        void addResults(const CacheModel& other)
+        {
+            readReqs += other.readReqs;
+            writeReqs += other.writeReqs;
+            readHits += other.readHits;
+            writeHits += other.writeHits;
+        }
+
+        // Writes readReqs, writeReqs, readHits and writeHits to counters
+        void getCounters(UINT64* counters)
+        {
+            counters[0] = readReqs;
+            counters[1] = writeReqs;
+            counters[2] = readHits;
+            counters[3] = writeHits;
+        }
+
+        //Do not modify this function
+        void dumpResults(FILE* outFile)
+        {
+            fprintf(outFile, "%lu,%lu,%lu,%lu\n", readReqs, writeReqs, readHits, writeHits);
+        }
+};
+
+template <template <UINT32> class Policy, UINT32 A>
+class LruPhysIndexPhysTagCacheModel: public CacheModel<Policy, A>
+{
+        typedef CacheModel<Policy, A> Base;
+
+    public:
+        LruPhysIndexPhysTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
+            : Base(logNumRowsParam, logBlockSizeParam, associativityParam)
+        {
+        }
+
+        bool access(UINT32 physicalAddr) {
+            //if (physicalAddr > highestPhysicalAddr) highestPhysicalAddr = virtualAddr;
+            //if (physicalAddr < lowestPhysicalAddr) lowestPhysicalAddr = virtualAddr;
+
+            UINT32 idx = this->getIdx(physicalAddr), j;
+            if (CACHE_DEBUG) printf("Searching %x in cache\n", physicalAddr);
+            bool isHit = this->searchAddr(physicalAddr, &j);
+            if (isHit) {
+                if (CACHE_DEBUG) printf("Got hit, updating metadata\n");
+                this->lruTouch(idx, j);
+                if (CACHE_DEBUG) printf("Access (HIT) successful\n");
+                return true;
+            }
+            if (CACHE_DEBUG) printf("Got miss, updating metadata\n");
+            UINT32 lru_j = this->lruHead(idx);
+            this->fill(idx, lru_j, this->getTag(physicalAddr));
+            if (CACHE_DEBUG) printf("Updating lruQ\n");
+            this->lruFill(idx, lru_j);
+            if (CACHE_DEBUG) printf("Access (MISS) successful\n");
+            return false;
+        }
+
+        // Returns whether the request hit
+        bool readReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->readReqs++;
+            if (!access(physicalAddr))
+                return false;
+            this->readHits++;
+            return true;
+        }
+
+        bool writeReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->writeReqs++;
+            if (!access(physicalAddr))
+                return false;
+            this->writeHits++;
+            return true;
+        }
+};
+
+// While the index fits in the page offset the virtual and physical index
+// agree and the tag is the usual physical tag. Once the index reaches
+// above the page offset the tag is the whole physical page number, so a
+// line is still found only through the virtual index it was filled with;
+// with synonym tracking each miss also looks for its physical line in the
+// rows the other virtual aliases of the page could index, counting the
+// fills that duplicate a resident line.
+template <template <UINT32> class Policy, UINT32 A>
+class LruVirIndexPhysTagCacheModel: public CacheModel<Policy, A>
+{
+        typedef CacheModel<Policy, A> Base;
+
+        UINT32   physTagShift;  // tagShift, or logPageSize when the index exceeds the page offset
+        bool     countSynonyms;
+        UINT64   synonyms;
+
+        bool findSynonym(UINT32 virtualAddr, UINT32 x_tag) {
+            UINT32 idx = this->getIdx(virtualAddr);
+            UINT32 fixedMask = (1u<<(logPageSize - this->logBlockSize)) - 1;
+            for (UINT32 r = idx & fixedMask; r <= this->rowMask; r += fixedMask + 1) {
+                UINT32 j;
+                if (r != idx && this->searchTag(x_tag, r, &j))
+                    return true;
+            }
+            return false;
+        }
+
+    public:
+        LruVirIndexPhysTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
+            : Base(logNumRowsParam, logBlockSizeParam, associativityParam),
+              physTagShift(this->tagShift < logPageSize ? this->tagShift : logPageSize),
+              countSynonyms(false), synonyms(0)
+        {
+            assert (logBlockSizeParam <= logPageSize);
+        }
+
+        // Synonyms only arise once the index exceeds the page offset
+        void trackSynonyms() {
+            countSynonyms = this->tagShift > logPageSize;
+        }
+
+        bool indexExceedsPage() {
+            return this->tagShift > logPageSize;
+        }
+
+        bool access(UINT32 virtualAddr, UINT32 physicalAddr) {
+            UINT32 idx = this->getIdx(virtualAddr), j;
+            UINT32 x_tag = physicalAddr >> physTagShift;
+            bool isHit = this->searchTag(x_tag, idx, &j);
+            if (isHit) {
+                this->lruTouch(idx, j);
+                return true;
+            }
+            if (countSynonyms && findSynonym(virtualAddr, x_tag))
+                synonyms++;
+            UINT32 lru_j = this->lruHead(idx);
+            this->fill(idx, lru_j, x_tag);
+            this->lruFill(idx, lru_j);
+            return false;
+        }
+
+        // Returns whether the request hit
+        bool readReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->readReqs++;
+            if (!access(virtualAddr, physicalAddr))
+                return false;
+            this->readHits++;
+            return true;
+        }
+
+        bool writeReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->writeReqs++;
+            if (!access(virtualAddr, physicalAddr))
+                return false;
+            this->writeHits++;
+            return true;
+        }
+
+        void addResults(const LruVirIndexPhysTagCacheModel& other)
+        {
+            Base::addResults(other);
+            synonyms += other.synonyms;
+        }
+
+        UINT64 getSynonyms() {
+            return synonyms;
+        }
+};
+
+// With several address spaces each tag carries the ASID above the address
+// bits, so lines of different processes never match. With synonym
+// tracking the model also remembers the physical line of every way and,
+// on each miss, looks for that physical line in the rows its other virtual
+// aliases could index, counting the fills a real VIVT cache would have to
+// resolve against a resident synonym.
+template <template <UINT32> class Policy, UINT32 A>
+class LruVirIndexVirTagCacheModel: public CacheModel<Policy, A>
+{
+        typedef CacheModel<Policy, A> Base;
+
+        UINT32   asidTag;       // the current ASID shifted above the tag bits
+        UINT32*  physLine;      // same layout as tag, NULL unless tracking synonyms
+        UINT64   synonyms;
+
+        UINT32 getAsidTag(UINT32 addr) {
+            return this->getTag(addr) | asidTag;
+        }
+
+        // Looks for physicalAddr's line in every row whose index agrees with
+        // virtualAddr's in the page offset bits
+        bool findSynonym(UINT32 virtualAddr, UINT32 physicalAddr) {
+            UINT32 line = physicalAddr >> this->logBlockSize;
+            UINT32 idx = this->getIdx(virtualAddr);
+            UINT32 pageBits = logPageSize > this->logBlockSize ? logPageSize - this->logBlockSize : 0;
+            UINT32 fixedMask = pageBits < this->logNumRows ? (1u<<pageBits) - 1 : this->rowMask;
+            for (UINT32 r = idx & fixedMask; r <= this->rowMask; r += fixedMask + 1) {
+                size_t row = (size_t) r * this->stride();
+                for (UINT32 j = 0; j < this->ways(); j++)
+                    if (this->tag[row + j] != INVALID_TAG && physLine[row + j] == line)
+                        return true;
+            }
+            return false;
+        }
+
+    public:
+        LruVirIndexVirTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
+            : Base(logNumRowsParam, logBlockSizeParam, associativityParam),
+              asidTag(0), physLine(NULL), synonyms(0)
+        {
+        }
+        ~LruVirIndexVirTagCacheModel()
+        {
+            delete[] physLine;
+        }
+
+        void trackSynonyms() {
+            physLine = new UINT32[(size_t) this->stride() << this->logNumRows];
+        }
+
+        // ASIDs must stay below 2^tagShift - 1 so no tag is INVALID_TAG
+        void setAsid(UINT32 asid) {
+            assert (asid == 0 || (this->tagShift < 32 && asid < (1u<<this->tagShift) - 1));
+            asidTag = asid ? asid << (32 - this->tagShift) : 0;
+        }
+
+        bool access(UINT32 virtualAddr, UINT32 physicalAddr) {
+            UINT32 idx = this->getIdx(virtualAddr), j;
+            UINT32 x_tag = getAsidTag(virtualAddr);
+            bool isHit = this->searchTag(x_tag, idx, &j);
+            if (isHit) {
+                this->lruTouch(idx, j);
+                return true;
+            }
+            if (physLine && findSynonym(virtualAddr, physicalAddr))
+                synonyms++;
+            UINT32 lru_j = this->lruHead(idx);
+            this->fill(idx, lru_j, x_tag);
+            if (physLine)
+                physLine[(size_t) idx * this->stride() + lru_j] = physicalAddr >> this->logBlockSize;
+            this->lruFill(idx, lru_j);
+            return false;
+        }
+
+        // Returns whether the request hit
+        bool readReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->readReqs++;
+            if (!access(virtualAddr, physicalAddr))
+                return false;
+            this->readHits++;
+            return true;
+        }
+
+        bool writeReq(UINT32 virtualAddr, UINT32 physicalAddr)
+        {
+            this->writeReqs++;
+            if (!access(virtualAddr, physicalAddr))
+                return false;
+            this->writeHits++;
+            return true;
+        }
+
+        void addResults(const LruVirIndexVirTagCacheModel& other)
+        {
+            Base::addResults(other);
+            synonyms += other.synonyms;
+        }
+
+        UINT64 getSynonyms() {
+            return synonyms;
+        }
+};
+
+// TLB over virtual page numbers: a virtually-indexed, virtually-tagged
+// cache whose blocks are pages. Hits and misses are counted separately for
+// loads and stores, in the same format as the caches.
+template <template <UINT32> class Policy>
+class TlbModel: public LruVirIndexVirTagCacheModel<Policy, 0>
+{
+        static UINT32 logRows(UINT32 entries, UINT32 associativity)
+        {
+            assert (associativity > 0 && entries % associativity == 0);
+            UINT32 rows = entries / associativity, log = 0;
+            while ((1u << log) < rows)
+                log++;
+            assert ((1u << log) == rows);
+            return log;
+        }
+
+    public:
+        TlbModel(UINT32 entries, UINT32 associativityParam)
+            : LruVirIndexVirTagCacheModel<Policy, 0>(logRows(entries, associativityParam), logPageSize, associativityParam)
+        {
+        }
+};
+
+// One level of a physically-addressed cache hierarchy. Unlike the lab1
+// models it keeps a dirty bit per way and honours the write policies:
+// write-back caches mark written blocks dirty and write them to the next
+// level on eviction, write-through caches forward every written word, and
+// without write-allocate write misses bypass the level. Misses fetch their
+// block from next, or from memory when next is NULL, and every transfer is
+// counted in bytes.
+template <template <UINT32> class Policy>
+class HierarchyCacheModel: public CacheModel<Policy, 0>
+{
+        typedef CacheModel<Policy, 0> Base;
+
+        bool                  writeBack;
+        bool                  writeAllocate;
+        UINT32                latency;      // cycles to hit in this level
+        UINT32                memLatency;   // cycles to fetch from memory, if last
+        HierarchyCacheModel*  next;
+        UINT8*                dirty;        // same layout as tag
+        UINT64                fillBytes;    // bytes read from the next level
+        UINT64                writeBytes;   // bytes written to the next level
+
+        // Sends [addr, addr + bytes) to the next level; off the critical path
+        void writeNext(UINT32 addr, UINT32 bytes) {
+            writeBytes += bytes;
+            if (!next)
+                return;
+            UINT32 step = bytes < (1u<<next->logBlockSize) ? bytes : (1u<<next->logBlockSize);
+            for (UINT32 off = 0; off < bytes; off += step)
+                next->access(addr + off, true);
+        }
+
+        // Fetches the block at addr from the next level, returning the cycles
+        UINT32 fetchNext(UINT32 addr) {
+            UINT32 bytes = 1u<<this->logBlockSize;
+            fillBytes += bytes;
+            if (!next)
+                return memLatency;
+            UINT32 step = bytes < (1u<<next->logBlockSize) ? bytes : (1u<<next->logBlockSize);
+            UINT32 cycles = 0;
+            for (UINT32 off = 0; off < bytes; off += step)
+                cycles += next->access(addr + off, false);
+            return cycles;
+        }
+
+    public:
+        HierarchyCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam,
+                bool writeBackParam, bool writeAllocateParam, UINT32 latencyParam, UINT32 memLatencyParam,
+                HierarchyCacheModel* nextParam)
+            : Base(logNumRowsParam, logBlockSizeParam, associativityParam)
+        {
+            writeBack = writeBackParam;
+            writeAllocate = writeAllocateParam;
+            latency = latencyParam;
+            memLatency = memLatencyParam;
+            next = nextParam;
+            dirty = new UINT8[(size_t) this->tagStride << this->logNumRows]();
+            fillBytes = 0;
+            writeBytes = 0;
+        }
+        ~HierarchyCacheModel()
+        {
+            delete[] dirty;
+        }
+
+        // Simulates one word access and returns its latency in cycles
+        UINT32 access(UINT32 addr, bool isWrite) {
+            UINT32 idx = this->getIdx(addr), j;
+            size_t row = (size_t) idx * this->stride();
+            if (isWrite)
+                this->writeReqs++;
+            else
+                this->readReqs++;
+
+            if (this->searchAddr(addr, &j)) {
+                if (isWrite)
+                    this->writeHits++;
+                else
+                    this->readHits++;
+                this->lruTouch(idx, j);
+            } else {
+                if (isWrite && !writeAllocate) {
+                    writeNext(addr, 4);
+                    return latency;
+                }
+                j = this->lruHead(idx);
+                if (dirty[row + j]) {
+                    writeNext(this->makeAddr(this->tag[row + j], idx, 0), 1u<<this->logBlockSize);
+                    dirty[row + j] = 0;
+                }
+                UINT32 cycles = fetchNext(this->makeAddr(this->getTag(addr), idx, 0));
+                this->fill(idx, j, this->getTag(addr));
+                this->lruFill(idx, j);
+                if (!isWrite)
+                    return latency + cycles;
+                if (writeBack)
+                    dirty[row + j] = 1;
+                else
+                    writeNext(addr, 4);
+                return latency + cycles;
+            }
+
+            if (isWrite) {
+                if (writeBack)
+                    dirty[row + j] = 1;
+                else
+                    writeNext(addr, 4);
+            }
+            return latency;
+        }
+
+        void addResults(const HierarchyCacheModel& other)
+        {
+            Base::addResults(other);
+            fillBytes += other.fillBytes;
+            writeBytes += other.writeBytes;
+        }
+
+        // Bytes read from and written to the next level
+        void dumpTraffic(FILE* outFile)
+        {
+            fprintf(outFile, "%lu,%lu\n", fillBytes, writeBytes);
+        }
+};
+
+// Parameters of one simulated configuration, set from the tool knobs
+struct CacheConfig
+{
+    UINT32 logNumRows;
+    UINT32 logBlockSize;
+    UINT32 associativity;
+    RecencyPolicy recency;
+    UINT32 tlbEntries;          // 0 disables the TLB model
+    UINT32 tlbAssociativity;
+    bool   hierarchy;           // enables the write-policy hierarchy below
+    bool   writeBack;
+    bool   writeAllocate;
+    UINT32 l2LogNumRows;
+    UINT32 l2LogBlockSize;
+    UINT32 l2Associativity;     // 0 leaves the hierarchy with one level
+    UINT32 l1Latency;
+    UINT32 l2Latency;
+    UINT32 memLatency;
+    UINT64 contextSwitchRefs;   // references between context switches, 0 for none
+    UINT32 numAsids;            // address spaces the switches rotate through
+    bool   asidTagged;          // tag VIVT lines and TLB entries instead of flushing
+    UINT32 sharedPagePercent;   // virtual pages mapped alike in every address space
+    bool   trackSynonyms;
+    UINT32 optWindow;           // references RECENCY_OPT looks ahead
+
+    CacheConfig()
+        : logNumRows(10), logBlockSize(5), associativity(2), recency(RECENCY_AGE),
+          tlbEntries(0), tlbAssociativity(4),
+          hierarchy(false), writeBack(true), writeAllocate(true),
+          l2LogNumRows(12), l2LogBlockSize(6), l2Associativity(0),
+          l1Latency(1), l2Latency(10), memLatency(100),
+          contextSwitchRefs(0), numAsids(2), asidTagged(false), sharedPagePercent(0),
+          trackSynonyms(false), optWindow(1u<<18)
+    {
+    }
+};
+
+// An L1 with the geometry of the lab1 models, backed by an optional L2 and
+// memory, both using the configured write policies. Addresses are
+// physical. The average memory access time counts demand fetches only;
+// write-backs and write-throughs are assumed to drain from a write buffer.
+template <template <UINT32> class Policy>
+class MemoryHierarchy
+{
+        HierarchyCacheModel<Policy>* l2;
+        HierarchyCacheModel<Policy>  l1;
+        UINT64                       cycles;
+
+    public:
+        MemoryHierarchy(const CacheConfig& config)
+            : l2(config.l2Associativity ?
+                    new HierarchyCacheModel<Policy>(config.l2LogNumRows, config.l2LogBlockSize, config.l2Associativity,
+                        config.writeBack, config.writeAllocate, config.l2Latency, config.memLatency, NULL) : NULL),
+              l1(config.logNumRows, config.logBlockSize, config.associativity,
+                    config.writeBack, config.writeAllocate, config.l1Latency, config.memLatency, l2),
+              cycles(0)
+        {
+        }
+        ~MemoryHierarchy()
+        {
+            delete l2;
+        }
+
+        void readReq(UINT32 physicalAddr)
+        {
+            cycles += l1.access(physicalAddr, false);
+        }
+
+        void writeReq(UINT32 physicalAddr)
+        {
+            cycles += l1.access(physicalAddr, true);
+        }
+
+        void addResults(const MemoryHierarchy& other)
+        {
+            l1.addResults(other.l1);
+            if (l2)
+                l2->addResults(*other.l2);
+            cycles += other.cycles;
+        }
+
+        // Hit counters of each level in the dumpResults() format, then the
+        // bytes moved across each boundary and the average access time
+        void dumpResults(FILE* outFile)
+        {
+            fprintf(outFile, "hierarchy l1: ");
+            l1.dumpResults(outFile);
+            if (l2) {
+                fprintf(outFile, "hierarchy l2: ");
+                l2->dumpResults(outFile);
+                fprintf(outFile, "traffic l1-l2 bytes (fill,write): ");
+                l1.dumpTraffic(outFile);
+                fprintf(outFile, "traffic l2-memory bytes (fill,write): ");
+                l2->dumpTraffic(outFile);
+            } else {
+                fprintf(outFile, "traffic l1-memory bytes (fill,write): ");
+                l1.dumpTraffic(outFile);
+            }
+            UINT64 counters[4];
+            l1.getCounters(counters);
+            UINT64 refs = counters[0] + counters[1];
+            fprintf(outFile, "amat cycles: %f\n", refs ? (double) cycles / refs : 0.0);
+        }
+};
+
+// One buffered reference. The address field is wide enough for the
+// ADDRINT Pin writes into it through INS_InsertFillBuffer; only its low
+// 32 bits are simulated.
+struct MemRef
+{
+    UINT64 virtualAddr;
+    UINT32 isWrite;
+};
+
+// The three caches and the optional TLB, in dumpResults() order
+static const UINT32 MAX_MODELS = 4;
+static const char* const MODEL_NAMES[MAX_MODELS] = {
+    "physical index physical tag", "virtual index physical tag", "virtual index virtual tag", "tlb"
+};
+
+// Accesses and misses of every model for one instruction
+struct PcStats
+{
+    UINT64 pc;      // 0 when the entry is empty
+    UINT64 accesses;
+    UINT64 misses[MAX_MODELS];
+};
+
+// Per-instruction miss counts, kept in an open-addressing table with
+// linear probing that doubles when half full. Nothing is allocated until
+// the first lookup, so simulators that never attribute misses pay nothing.
+class PcMissTable
+{
+        PcStats* entries;
+        UINT32   mask;
+        UINT32   numEntries;
+
+        PcStats* find(UINT64 pc) {
+            UINT32 i = (UINT32) ((pc * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+            while (entries[i].pc && entries[i].pc != pc)
+                i = (i + 1) & mask;
+            return &entries[i];
+        }
+
+        void grow() {
+            PcStats* old = entries;
+            UINT32 oldSize = entries ? mask + 1 : 0;
+            mask = oldSize ? oldSize * 2 - 1 : 4095;
+            entries = new PcStats[mask + 1]();
+            for (UINT32 i = 0; i < oldSize; i++)
+                if (old[i].pc)
+                    *find(old[i].pc) = old[i];
+            delete[] old;
+        }
+
+    public:
+        PcMissTable() : entries(NULL), mask(0), numEntries(0) { }
+
+        ~PcMissTable()
+        {
+            delete[] entries;
+        }
+
+        // Returns the entry of pc, inserting a zeroed one if needed
+        PcStats* lookup(UINT64 pc) {
+            if (!entries)
+                grow();
+            PcStats* e = find(pc);
+            if (e->pc)
+                return e;
+            if (++numEntries * 2 > mask) {
+                grow();
+                e = find(pc);
+            }
+            e->pc = pc;
+            return e;
+        }
+
+        void addResults(PcMissTable& other) {
+            for (UINT32 i = 0; other.entries && i <= other.mask; i++) {
+                const PcStats& o = other.entries[i];
+                if (!o.pc)
+                    continue;
+                PcStats* e = lookup(o.pc);
+                e->accesses += o.accesses;
+                for (UINT32 m = 0; m < MAX_MODELS; m++)
+                    e->misses[m] += o.misses[m];
+            }
+        }
+
+        UINT32 size() {
+            return numEntries;
+        }
+
+        // Copies the size() entries into out, in no particular order
+        void collect(PcStats* out) {
+            for (UINT32 i = 0; entries && i <= mask; i++)
+                if (entries[i].pc)
+                    *out++ = entries[i];
+        }
+};
+
+// Run-time handle on one configuration of the three models. load and store
+// point at a fully inlined routine that drives all three models for one
+// reference, so the Pin tool can insert them directly as analysis routines
+// with the simulator passed through IARG_PTR.
+class CacheSimulator
+{
+    public:
+        typedef void (*AccessFunction)(CacheSimulator* sim, UINT32 virtualAddr);
+        typedef void (*BatchFunction)(CacheSimulator* sim, const MemRef* refs, UINT64 numRefs);
+        typedef void (*PcAccessFunction)(CacheSimulator* sim, UINT64 pc, UINT32 virtualAddr);
+
+        AccessFunction load;
+        AccessFunction store;
+        BatchFunction  batch;   // simulates a buffer of references in order
+        // Same as load and store, also charging the misses to pc in pcTable
+        PcAccessFunction loadPc;
+        PcAccessFunction storePc;
+        PcMissTable    pcTable;
+
+        virtual ~CacheSimulator() { }
+
+        // Writes the three models' counters in the format the lab scripts expect
+        virtual void dumpResults(FILE* outFile) = 0;
+
+        // Adds the counters of other, which must come from the same config
+        virtual void addResults(CacheSimulator* other) = 0;
+
+        // Fills one getCounters() row per model and returns the number of models
+        virtual UINT32 getCounters(UINT64 counters[][4]) = 0;
+};
+
+template <template <UINT32> class Policy, UINT32 A>
+class CacheModelSet: public CacheSimulator
+{
+        LruPhysIndexPhysTagCacheModel<Policy, A> cachePP;
+        LruVirIndexPhysTagCacheModel<Policy, A>  cacheVP;
+        LruVirIndexVirTagCacheModel<Policy, A>   cacheVV;
+        TlbModel<Policy>*                        tlb;
+        MemoryHierarchy<Policy>*                 hierarchy;
+        TranslationMemo                          memo;
+        UINT64                                   contextSwitchRefs;
+        UINT64                                   refsSinceSwitch;
+        UINT64                                   contextSwitches;
+        UINT32                                   numAsids;
+        UINT32                                   asid;
+        bool                                     asidTagged;
+        bool                                     trackSynonyms;
+        UINT32                                   sharedPagePercent;
+
+        // Moves to the next address space. The physically-tagged caches
+        // keep their lines; the VIVT cache and the TLB are flushed unless
+        // their entries carry ASIDs.
+        void contextSwitch()
+        {
+            contextSwitches++;
+            asid = (asid + 1) % numAsids;
+            memo.setAsid(asid, sharedPagePercent);
+            if (asidTagged) {
+                cacheVV.setAsid(asid);
+                if (tlb)
+                    tlb->setAsid(asid);
+            } else {
+                cacheVV.flush();
+                if (tlb)
+                    tlb->flush();
+            }
+        }
+
+        // Counts one reference towards the next context switch and returns
+        // its physical address in the current address space
+        UINT32 translate(UINT32 virtualAddr)
+        {
+            if (contextSwitchRefs && ++refsSinceSwitch == contextSwitchRefs) {
+                refsSinceSwitch = 0;
+                contextSwitch();
+            }
+            return memo.getPhysicalAddr(virtualAddr);
+        }
+
+        static void loadRef(CacheSimulator* sim, UINT32 virtualAddr)
+        {
+            CacheModelSet* set = static_cast<CacheModelSet*>(sim);
+            //Here the virtual address is aligned to a word boundary
+            virtualAddr = (virtualAddr >> 2) << 2;
+            UINT32 physicalAddr = set->translate(virtualAddr);
+            set->cachePP.readReq(virtualAddr, physicalAddr);
+            set->cacheVP.readReq(virtualAddr, physicalAddr);
+            set->cacheVV.readReq(virtualAddr, physicalAddr);
+            if (set->tlb)
+                set->tlb->readReq(virtualAddr, physicalAddr);
+            if (set->hierarchy)
+                set->hierarchy->readReq(physicalAddr);
+        }
+
+        static void storeRef(CacheSimulator* sim, UINT32 virtualAddr)
+        {
+            CacheModelSet* set = static_cast<CacheModelSet*>(sim);
+            //Here the virtual address is aligned to a word boundary
+            virtualAddr = (virtualAddr >> 2) << 2;
+            UINT32 physicalAddr = set->translate(virtualAddr);
+            set->cachePP.writeReq(virtualAddr, physicalAddr);
+            set->cacheVP.writeReq(virtualAddr, physicalAddr);
+            set->cacheVV.writeReq(virtualAddr, physicalAddr);
+            if (set->tlb)
+                set->tlb->writeReq(virtualAddr, physicalAddr);
+            if (set->hierarchy)
+                set->hierarchy->writeReq(physicalAddr);
+        }
+
+        static void loadPcRef(CacheSimulator* sim, UINT64 pc, UINT32 virtualAddr)
+        {
+            CacheModelSet* set = static_cast<CacheModelSet*>(sim);
+            virtualAddr = (virtualAddr >> 2) << 2;
+            UINT32 physicalAddr = set->translate(virtualAddr);
+            PcStats* e = set->pcTable.lookup(pc);
+            e->accesses++;
+            e->misses[0] += !set->cachePP.readReq(virtualAddr, physicalAddr);
+            e->misses[1] += !set->cacheVP.readReq(virtualAddr, physicalAddr);
+            e->misses[2] += !set->cacheVV.readReq(virtualAddr, physicalAddr);
+            if (set->tlb)
+                e->misses[3] += !set->tlb->readReq(virtualAddr, physicalAddr);
+            if (set->hierarchy)
+                set->hierarchy->readReq(physicalAddr);
+        }
+
+        static void storePcRef(CacheSimulator* sim, UINT64 pc, UINT32 virtualAddr)
+        {
+            CacheModelSet* set = static_cast<CacheModelSet*>(sim);
+            virtualAddr = (virtualAddr >> 2) << 2;
+            UINT32 physicalAddr = set->translate(virtualAddr);
+            PcStats* e = set->pcTable.lookup(pc);
+            e->accesses++;
+            e->misses[0] += !set->cachePP.writeReq(virtualAddr, physicalAddr);
+            e->misses[1] += !set->cacheVP.writeReq(virtualAddr, physicalAddr);
+            e->misses[2] += !set->cacheVV.writeReq(virtualAddr, physicalAddr);
+            if (set->tlb)
+                e->misses[3] += !set->tlb->writeReq(virtualAddr, physicalAddr);
+            if (set->hierarchy)
+                set->hierarchy->writeReq(physicalAddr);
+        }
+
+        static void batchRefs(CacheSimulator* sim, const MemRef* refs, UINT64 numRefs)
+        {
+            for (UINT64 i = 0; i < numRefs; i++) {
+                if (refs[i].isWrite)
+                    storeRef(sim, (UINT32) refs[i].virtualAddr);
+                else
+                    loadRef(sim, (UINT32) refs[i].virtualAddr);
+            }
+        }
+
+    public:
+        CacheModelSet(const CacheConfig& config)
+            : cachePP(config.logNumRows, config.logBlockSize, config.associativity),
+              cacheVP(config.logNumRows, config.logBlockSize, config.associativity),
+              cacheVV(config.logNumRows, config.logBlockSize, config.associativity),
+              tlb(NULL), hierarchy(NULL),
+              contextSwitchRefs(config.contextSwitchRefs), refsSinceSwitch(0), contextSwitches(0),
+              numAsids(config.numAsids), asid(0), asidTagged(config.asidTagged),
+              trackSynonyms(config.trackSynonyms), sharedPagePercent(config.sharedPagePercent)
+        {
+            assert (numAsids > 0);
+            if (trackSynonyms) {
+                cacheVP.trackSynonyms();
+                cacheVV.trackSynonyms();
+            }
+            if (config.tlbEntries)
+                tlb = new TlbModel<Policy>(config.tlbEntries, config.tlbAssociativity);
+            if (config.hierarchy)
+                hierarchy = new MemoryHierarchy<Policy>(config);
+            load = &loadRef;
+            store = &storeRef;
+            batch = &batchRefs;
+            loadPc = &loadPcRef;
+            storePc = &storePcRef;
+        }
+        ~CacheModelSet()
+        {
+            delete tlb;
+            delete hierarchy;
+        }
+
+        void dumpResults(FILE* outFile)
+        {
+            fprintf(outFile, "physical index physical tag: ");
+            cachePP.dumpResults(outFile);
+            fprintf(outFile, "virtual index physical tag: ");
+            cacheVP.dumpResults(outFile);
+            fprintf(outFile, "virtual index virtual tag: ");
+            cacheVV.dumpResults(outFile);
+            if (tlb) {
+                fprintf(outFile, "tlb: ");
+                tlb->dumpResults(outFile);
+            }
+            if (hierarchy)
+                hierarchy->dumpResults(outFile);
+            if (contextSwitchRefs)
+                fprintf(outFile, "context switches: %lu\n", contextSwitches);
+            if (trackSynonyms && cacheVP.indexExceedsPage())
+                fprintf(outFile, "virtual index physical tag synonyms: %lu\n", cacheVP.getSynonyms());
+            if (trackSynonyms)
+                fprintf(outFile, "virtual index virtual tag synonyms: %lu\n", cacheVV.getSynonyms());
+        }
+
+        void addResults(CacheSimulator* other)
+        {
+            CacheModelSet* set = static_cast<CacheModelSet*>(other);
+            cachePP.addResults(set->cachePP);
+            cacheVP.addResults(set->cacheVP);
+            cacheVV.addResults(set->cacheVV);
+            if (tlb)
+                tlb->addResults(*set->tlb);
+            if (hierarchy)
+                hierarchy->addResults(*set->hierarchy);
+            contextSwitches += set->contextSwitches;
+        }
+
+        UINT32 getCounters(UINT64 counters[][4])
+        {
+            cachePP.getCounters(counters[0]);
+            cacheVP.getCounters(counters[1]);
+            cacheVV.getCounters(counters[2]);
+            if (!tlb)
+                return 3;
+            tlb->getCounters(counters[3]);
+            return 4;
+        }
+};
+
+// Picks the specialization for the common power of two associativities,
+// falling back to the run-time associativity otherwise
+template <template <UINT32> class Policy>
+CacheSimulator* makeCacheSimulator(const CacheConfig& config)
+{
+    switch (config.associativity) {
+        case 1:  return new CacheModelSet<Policy, 1>(config);
+        case 2:  return new CacheModelSet<Policy, 2>(config);
+        case 4:  return new CacheModelSet<Policy, 4>(config);
+        case 8:  return new CacheModelSet<Policy, 8>(config);
+        case 16: return new CacheModelSet<Policy, 16>(config);
+        case 32: return new CacheModelSet<Policy, 32>(config);
+        default: return new CacheModelSet<Policy, 0>(config);
+    }
+}
+
+// Runs a simulator using BeladyOpt optWindow references behind the
+// reference stream, so its policies know where each simulated reference
+// is next used. The references still in the window are simulated before
+// any results are read.
+class LookaheadSimulator: public CacheSimulator
+{
+        NextUseWindow   window;
+        CacheSimulator* sim;
+
+        void step()
+        {
+            UINT32 addr;
+            bool isWrite;
+            window.pop(&addr, &isWrite);
+            if (isWrite)
+                sim->store(sim, addr);
+            else
+                sim->load(sim, addr);
+        }
+
+        void drain()
+        {
+            while (!window.empty())
+                step();
+        }
+
+        static void access(CacheSimulator* base, UINT32 virtualAddr, bool isWrite)
+        {
+            LookaheadSimulator* ls = static_cast<LookaheadSimulator*>(base);
+            if (ls->window.full())
+                ls->step();
+            ls->window.push(virtualAddr, isWrite);
+        }
+
+        static void loadRef(CacheSimulator* base, UINT32 virtualAddr)
+        {
+            access(base, virtualAddr, false);
+        }
+
+        static void storeRef(CacheSimulator* base, UINT32 virtualAddr)
+        {
+            access(base, virtualAddr, true);
+        }
+
+        static void batchRefs(CacheSimulator* base, const MemRef* refs, UINT64 numRefs)
+        {
+            for (UINT64 i = 0; i < numRefs; i++)
+                access(base, (UINT32) refs[i].virtualAddr, refs[i].isWrite);
+        }
+
+    public:
+        // Sets currentNextUseWindow() for the models makeSim() constructs
+        LookaheadSimulator(const CacheConfig& config, CacheSimulator* (*makeSim)(const CacheConfig&))
+            : window(config.optWindow)
+        {
+            assert (currentNextUseWindow() == NULL);
+            currentNextUseWindow() = &window;
+            sim = makeSim(config);
+            currentNextUseWindow() = NULL;
+            load = &loadRef;
+            store = &storeRef;
+            batch = &batchRefs;
+            loadPc = NULL;
+            storePc = NULL;
+        }
+        ~LookaheadSimulator()
+        {
+            delete sim;
+        }
+
+        void dumpResults(FILE* outFile)
+        {
+            drain();
+            sim->dumpResults(outFile);
+        }
+
+        // Only meaningful when both simulators have been drained
+        void addResults(CacheSimulator* other)
+        {
+            LookaheadSimulator* ls = static_cast<LookaheadSimulator*>(other);
+            drain();
+            ls->drain();
+            sim->addResults(ls->sim);
+        }
+
+        UINT32 getCounters(UINT64 counters[][4])
+        {
+            drain();
+            return sim->getCounters(counters);
+        }
+};
+
+inline CacheSimulator* makeCacheSimulator(const CacheConfig& config)
+{
+    switch (config.recency) {
+        case RECENCY_QUEUE:  return makeCacheSimulator<QueueLru>(config);
+        case RECENCY_AGE:
+            // Ages are bytes, so rows of 256 ways or more fall back to the
+            // queue, which picks the same victims
+            if (config.associativity >= 256 || config.tlbAssociativity >= 256 || config.l2Associativity >= 256)
+                return makeCacheSimulator<QueueLru>(config);
+            return makeCacheSimulator<AgeLru>(config);
+        case RECENCY_MATRIX: return makeCacheSimulator<MatrixLru>(config);
+        case RECENCY_PLRU:   return makeCacheSimulator<TreePlru>(config);
+        case RECENCY_RANDOM: return makeCacheSimulator<RandomReplacement>(config);
+        case RECENCY_FIFO:   return makeCacheSimulator<FifoReplacement>(config);
+        case RECENCY_NRU:    return makeCacheSimulator<NruReplacement>(config);
+        case RECENCY_SRRIP:  return makeCacheSimulator<SrripReplacement>(config);
+        case RECENCY_BRRIP:  return makeCacheSimulator<BrripReplacement>(config);
+        case RECENCY_OPT:    return new LookaheadSimulator(config, &makeCacheSimulator<BeladyOpt>);
+        default:             return NULL;
+    }
+}
+
+// Hit rate of each model over systematic samples of the reference stream.
+// begin() and end() bracket one measured interval; the models keep running
+// in between intervals, so warmup references only need to be simulated.
+// Each interval is one sample of the hit rate, and the report gives the
+// mean over the samples with a 95% confidence interval from their variance.
+class SampledHitRates
+{
+        UINT64  start[MAX_MODELS][4];
+        UINT64  numSamples[MAX_MODELS];
+        double  sum[MAX_MODELS];
+        double  sumSquares[MAX_MODELS];
+        UINT32  numModels;
+
+    public:
+        SampledHitRates() : numModels(0)
+        {
+            for (UINT32 i = 0; i < MAX_MODELS; i++) {
+                numSamples[i] = 0;
+                sum[i] = 0;
+                sumSquares[i] = 0;
+            }
+        }
+
+        void begin(CacheSimulator* sim)
+        {
+            numModels = sim->getCounters(start);
+        }
+
+        void end(CacheSimulator* sim)
+        {
+            UINT64 now[MAX_MODELS][4];
+            sim->getCounters(now);
+            for (UINT32 i = 0; i < numModels; i++) {
+                UINT64 reqs = now[i][0] + now[i][1] - start[i][0] - start[i][1];
+                UINT64 hits = now[i][2] + now[i][3] - start[i][2] - start[i][3];
+                if (reqs == 0)
+                    continue; // an interval without references
+                double rate = (double) hits / reqs;
+                numSamples[i]++;
+                sum[i] += rate;
+                sumSquares[i] += rate * rate;
+            }
+        }
+
+        // One line per model: samples, mean hit rate, 95% confidence half-width
+        void dumpResults(FILE* outFile)
+        {
+            for (UINT32 i = 0; i < numModels; i++) {
+                UINT64 n = numSamples[i];
+                double mean = n ? sum[i] / n : 0;
+                double ci = 0;
+                if (n > 1) {
+                    double variance = (sumSquares[i] - n * mean * mean) / (n - 1);
+                    ci = 1.96 * sqrt(variance > 0 ? variance / n : 0);
+                }
+                fprintf(outFile, "sampled %s: %lu,%f,%f\n", MODEL_NAMES[i], n, mean, ci);
+            }
+        }
+};
+
+// Mattson stack-distance simulation of every LRU cache sharing one block
+// size. Each set count 2^0 .. 2^maxLogNumRows keeps its own per-set LRU
+// stack of block addresses, truncated at maxAssociativity entries, so a
+// single pass yields the hits of every (logNumRows, associativity) point:
+// a reference at stack distance d hits in every cache with more than d ways.
+class StackDistanceModel
+{
+    protected:
+        UINT32   maxLogNumRows;
+        UINT32   logBlockSize;
+        UINT32   maxAssociativity;
+        UINT64   readReqs;
+        UINT64   writeReqs;
+        UINT32** stacks;    // [logNumRows][set * maxAssociativity + d], MRU first
+        UINT32** depth;     // [logNumRows][set], valid entries in each stack
+        UINT64** readHits;  // [logNumRows][d], read hits at stack distance d
+        UINT64** writeHits; // [logNumRows][d], write hits at stack distance d
+
+        // The set comes from indexAddr and the stack holds addr's blocks;
+        // they differ only for the virtually-indexed physically-tagged cache
+        void access(UINT32 indexAddr, UINT32 addr, UINT64** hits) {
+            UINT32 block = addr >> logBlockSize;
+            for (UINT32 r = 0; r <= maxLogNumRows; r++) {
+                UINT32 set = (indexAddr >> logBlockSize) & ((1u<<r)-1);
+                UINT32* stack = stacks[r] + set * maxAssociativity;
+                UINT32 n = depth[r][set];
+                UINT32 d = 0;
+                while (d < n && stack[d] != block)
+                    d++;
+                if (d < n)
+                    hits[r][d]++;
+                else if (n < maxAssociativity)
+                    depth[r][set] = n + 1;
+                else
+                    d = maxAssociativity - 1; // the LRU block falls off
+                memmove(stack + 1, stack, d * sizeof(UINT32));
+                stack[0] = block;
+            }
+        }
+
+    public:
+        StackDistanceModel(UINT32 maxLogNumRowsParam, UINT32 logBlockSizeParam, UINT32 maxAssociativityParam)
+        {
+            maxLogNumRows = maxLogNumRowsParam;
+            logBlockSize = logBlockSizeParam;
+            maxAssociativity = maxAssociativityParam;
+            readReqs = 0;
+            writeReqs = 0;
+            stacks = new UINT32*[maxLogNumRows + 1];
+            depth = new UINT32*[maxLogNumRows + 1];
+            readHits = new UINT64*[maxLogNumRows + 1];
+            writeHits = new UINT64*[maxLogNumRows + 1];
+            for (UINT32 r = 0; r <= maxLogNumRows; r++) {
+                stacks[r] = new UINT32[(1u<<r) * maxAssociativity];
+                depth[r] = new UINT32[1u<<r]();
+                readHits[r] = new UINT64[maxAssociativity]();
+                writeHits[r] = new UINT64[maxAssociativity]();
+            }
+        }
+
+        ~StackDistanceModel()
+        {
+            for (UINT32 r = 0; r <= maxLogNumRows; r++) {
+                delete[] stacks[r];
+                delete[] depth[r];
+                delete[] readHits[r];
+                delete[] writeHits[r];
+            }
+            delete[] stacks;
+            delete[] depth;
+            delete[] readHits;
+            delete[] writeHits;
+        }
+
+        void readReq(UINT32 addr)
+        {
+            readReq(addr, addr);
+        }
+
+        void writeReq(UINT32 addr)
+        {
+            writeReq(addr, addr);
+        }
+
+        void readReq(UINT32 indexAddr, UINT32 addr)
+        {
+            readReqs++;
+            access(indexAddr, addr, readHits);
+        }
+
+        void writeReq(UINT32 indexAddr, UINT32 addr)
+        {
+            writeReqs++;
+            access(indexAddr, addr, writeHits);
+        }
+
+        UINT32 getMaxLogNumRows() {
+            return maxLogNumRows;
+        }
+        UINT32 getLogBlockSize() {
+            return logBlockSize;
+        }
+        UINT32 getMaxAssociativity() {
+            return maxAssociativity;
+        }
+
+        // Same format as CacheModel::dumpResults() for one configuration
+        void dumpResults(FILE* outFile, UINT32 logNumRows, UINT32 associativity)
+        {
+            assert (logNumRows <= maxLogNumRows);
+            assert (associativity <= maxAssociativity);
+            UINT64 rh = 0, wh = 0;
+            for (UINT32 d = 0; d < associativity; d++) {
+                rh += readHits[logNumRows][d];
+                wh += writeHits[logNumRows][d];
+            }
+            fprintf(outFile, "%lu,%lu,%lu,%lu\n", readReqs, writeReqs, rh, wh);
+        }
+};
+
+// Whether the virtually-indexed physically-tagged points need their own
+// model, indexed by the virtual and tagged by the physical address; while
+// the index fits in the page offset they behave like the physical ones
+inline bool stackDistanceNeedsVirtPhys(UINT32 maxLogNumRows, UINT32 logBlockSize)
+{
+    return logBlockSize + maxLogNumRows > logPageSize;
+}
+
+// Writes the hit matrix of every (logNumRows, associativity) point. phys
+// sees physical addresses, virt virtual ones and virtPhys, NULL unless
+// stackDistanceNeedsVirtPhys(), both.
+inline void dumpStackDistanceResults(FILE* outFile, StackDistanceModel* phys, StackDistanceModel* virtPhys,
+        StackDistanceModel* virt)
+{
+    for (UINT32 r = 0; r <= phys->getMaxLogNumRows(); r++) {
+        for (UINT32 a = 1; a <= phys->getMaxAssociativity(); a++) {
+            fprintf(outFile, "logNumRows %u associativity %u physical index physical tag: ", r, a);
+            phys->dumpResults(outFile, r, a);
+            fprintf(outFile, "logNumRows %u associativity %u virtual index physical tag: ", r, a);
+            if (phys->getLogBlockSize() + r > logPageSize)
+                virtPhys->dumpResults(outFile, r, a);
+            else
+                phys->dumpResults(outFile, r, a);
+            fprintf(outFile, "logNumRows %u associativity %u virtual index virtual tag: ", r, a);
+            virt->dumpResults(outFile, r, a);
+        }
+    }
+}
+
+// Reuse distances are binned by powers of two: bin 0 holds distance 0 and
+// bin b the distances in [2^(b-1), 2^b)
+static const UINT32 REUSE_BINS = 33;
+
+// Fully-associative LRU reuse distance of every reference in lines of
+// 2^logBlockSize bytes, i.e. the number of distinct other lines touched
+// since the previous reference to the same line. Olken's method keeps each
+// line's last access time in a hash table and a Fenwick tree over time with
+// a 1 at the last access time of every line, so a distance is one prefix
+// sum. Times are renumbered densely whenever the tree fills. A reference at
+// distance d misses in every fully-associative LRU cache of at most d
+// lines, which gives the whole miss ratio curve from one pass. The number
+// of distinct lines in each interval of intervalRefs references tracks the
+// working set over time.
+class ReuseDistanceModel
+{
+        UINT32   logBlockSize;
+        UINT64   intervalRefs;
+        UINT64   readHist[REUSE_BINS];
+        UINT64   writeHist[REUSE_BINS];
+        UINT64   readCold;
+        UINT64   writeCold;
+
+        // Open-addressing table of line -> last access time; lines are at
+        // most 30 bits since blocks are at least a word, so ~0 marks empty
+        UINT32*  lines;
+        UINT32*  times;
+        UINT32   tableMask;
+        UINT32   numLines;
+
+        // Fenwick tree over times 1 .. capacity and the line last accessed
+        // at each time, ~0 once that line has been accessed again
+        UINT32*  tree;
+        UINT32*  owner;
+        UINT32   capacity;
+        UINT32   now;           // next time to hand out, starting at 1
+
+        UINT32   intervalStart; // time of the current interval's first reference
+        UINT64   intervalPos;
+        UINT64   intervalLines;
+        UINT64*  workingSet;
+        UINT64   numIntervals;
+        UINT64   workingSetCapacity;
+
+        static UINT32 hash(UINT32 line) {
+            return line * 2654435761u;
+        }
+
+        UINT32 findSlot(UINT32 line) {
+            UINT32 i = hash(line) & tableMask;
+            while (lines[i] != ~0u && lines[i] != line)
+                i = (i + 1) & tableMask;
+            return i;
+        }
+
+        void growTable() {
+            UINT32* oldLines = lines;
+            UINT32* oldTimes = times;
+            UINT32 oldSize = tableMask + 1;
+            tableMask = oldSize * 2 - 1;
+            lines = new UINT32[oldSize * 2];
+            times = new UINT32[oldSize * 2];
+            memset(lines, 0xff, oldSize * 2 * sizeof(UINT32));
+            for (UINT32 i = 0; i < oldSize; i++) {
+                if (oldLines[i] == ~0u)
+                    continue;
+                UINT32 j = findSlot(oldLines[i]);
+                lines[j] = oldLines[i];
+                times[j] = oldTimes[i];
+            }
+            delete[] oldLines;
+            delete[] oldTimes;
+        }
+
+        void treeAdd(UINT32 t, INT32 delta) {
+            for (; t <= capacity; t += t & -t)
+                tree[t] += delta;
+        }
+
+        UINT32 treePrefix(UINT32 t) {
+            UINT32 sum = 0;
+            for (; t; t -= t & -t)
+                sum += tree[t];
+            return sum;
+        }
+
+        // Renumbers the live times to 1 .. numLines, keeping their order,
+        // and doubles the tree when more than half of it would stay in use
+        void compact() {
+            UINT32 newCapacity = numLines * 2 > capacity ? capacity * 2 : capacity;
+            UINT32* newOwner = new UINT32[newCapacity + 1];
+            UINT32 k = 0, newIntervalStart = 0;
+            for (UINT32 t = 1; t < now; t++) {
+                if (t == intervalStart)
+                    newIntervalStart = k + 1;
+                if (owner[t] == ~0u)
+                    continue;
+                newOwner[++k] = owner[t];
+                times[findSlot(owner[t])] = k;
+            }
+            intervalStart = newIntervalStart ? newIntervalStart : k + 1;
+            delete[] owner;
+            delete[] tree;
+            owner = newOwner;
+            capacity = newCapacity;
+            tree = new UINT32[capacity + 1]();
+            for (UINT32 t = 1; t <= capacity; t++) {
+                if (t <= k)
+                    tree[t] += 1;
+                UINT32 parent = t + (t & -t);
+                if (parent <= capacity)
+                    tree[parent] += tree[t];
+            }
+            now = k + 1;
+        }
+
+        void access(UINT32 addr, UINT64* hist, UINT64* cold) {
+            UINT32 line = addr >> logBlockSize;
+            UINT32 slot = findSlot(line);
+            bool newInInterval;
+            if (lines[slot] == ~0u) {
+                (*cold)++;
+                newInInterval = true;
+                lines[slot] = line;
+                numLines++;
+            } else {
+                UINT32 last = times[slot];
+                UINT32 d = numLines - treePrefix(last);
+                UINT32 bin = 0;
+                while (d >> bin)
+                    bin++;
+                hist[bin]++;
+                newInInterval = last < intervalStart;
+                treeAdd(last, -1);
+                owner[last] = ~0u;
+            }
+            times[slot] = now;
+            owner[now] = line;
+            treeAdd(now, 1);
+            now++;
+
+            if (newInInterval)
+                intervalLines++;
+            if (intervalRefs && ++intervalPos == intervalRefs) {
+                if (numIntervals == workingSetCapacity) {
+                    UINT64* old = workingSet;
+                    workingSetCapacity = workingSetCapacity ? workingSetCapacity * 2 : 1024;
+                    workingSet = new UINT64[workingSetCapacity];
+                    memcpy(workingSet, old, numIntervals * sizeof(UINT64));
+                    delete[] old;
+                }
+                workingSet[numIntervals++] = intervalLines;
+                intervalPos = 0;
+                intervalLines = 0;
+                intervalStart = now;
+            }
+
+            if (numLines * 2 > tableMask)
+                growTable();
+            if (now > capacity)
+                compact();
+        }
+
+    public:
+        ReuseDistanceModel(UINT32 logBlockSizeParam, UINT64 intervalRefsParam)
+        {
+            logBlockSize = logBlockSizeParam;
+            intervalRefs = intervalRefsParam;
+            for (UINT32 b = 0; b < REUSE_BINS; b++) {
+                readHist[b] = 0;
+                writeHist[b] = 0;
+            }
+            readCold = 0;
+            writeCold = 0;
+            tableMask = (1u<<16) - 1;
+            lines = new UINT32[tableMask + 1];
+            times = new UINT32[tableMask + 1];
+            memset(lines, 0xff, (tableMask + 1) * sizeof(UINT32));
+            numLines = 0;
+            capacity = 1u<<20;
+            tree = new UINT32[capacity + 1]();
+            owner = new UINT32[capacity + 1];
+            now = 1;
+            intervalStart = 1;
+            intervalPos = 0;
+            intervalLines = 0;
+            workingSet = NULL;
+            numIntervals = 0;
+            workingSetCapacity = 0;
+        }
+
+        ~ReuseDistanceModel()
+        {
+            delete[] lines;
+            delete[] times;
+            delete[] tree;
+            delete[] owner;
+            delete[] workingSet;
+        }
+
+        void readReq(UINT32 addr)
+        {
+            access(addr, readHist, &readCold);
+        }
+
+        void writeReq(UINT32 addr)
+        {
+            access(addr, writeHist, &writeCold);
+        }
+
+        // Writes the histogram as "lo,hi,reads,writes" lines for distances
+        // in [lo, hi), the cold references, the misses of a fully-associative
+        // LRU cache of every power of two number of lines, and the distinct
+        // lines of every complete interval
+        void dumpResults(FILE* outFile)
+        {
+            UINT32 top = REUSE_BINS;
+            while (top > 1 && !readHist[top - 1] && !writeHist[top - 1])
+                top--;
+            fprintf(outFile, "reuse distance histogram (lines of %u bytes):\n", 1u<<logBlockSize);
+            for (UINT32 b = 0; b < top; b++) {
+                UINT64 lo = b ? (UINT64) 1 << (b - 1) : 0, hi = (UINT64) 1 << b;
+                fprintf(outFile, "%lu,%lu,%lu,%lu\n", lo, hi, readHist[b], writeHist[b]);
+            }
+            fprintf(outFile, "cold: %lu,%lu\n", readCold, writeCold);
+
+            // A cache of 2^k lines misses on distances >= 2^k, i.e. bins > k
+            fprintf(outFile, "fully associative LRU misses (lines,readMisses,writeMisses):\n");
+            for (UINT32 k = 0; k < top; k++) {
+                UINT64 rm = readCold, wm = writeCold;
+                for (UINT32 b = k + 1; b < top; b++) {
+                    rm += readHist[b];
+                    wm += writeHist[b];
+                }
+                fprintf(outFile, "%lu,%lu,%lu\n", (UINT64) 1 << k, rm, wm);
+            }
+
+            if (intervalRefs) {
+                fprintf(outFile, "working set (interval,lines) every %lu references:\n", intervalRefs);
+                for (UINT64 i = 0; i < numIntervals; i++)
+                    fprintf(outFile, "%lu,%lu\n", i, workingSet[i]);
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,653 @@
+#ifndef CACHE_POLICIES_H
+#define CACHE_POLICIES_H
+
+#include <string.h>
+#include <assert.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "cache_types.h"
+
+static const UINT32 CACHE_ALIGNMENT = 64;
+
+// Replacement policies CacheModel can use within a row. QUEUE, AGE and
+// MATRIX are exact LRU and pick identical victims; PLRU approximates LRU
+// with a binary tree and needs a power of two associativity. The others
+// are not recency based, and OPT needs to see the references ahead.
+enum RecencyPolicy
+{
+    RECENCY_QUEUE,  // ways ordered LRU to MRU, shifted on every touch
+    RECENCY_AGE,    // per-way age counters updated 16 ways per SSE2 instruction
+    RECENCY_MATRIX, // per-way bit rows, row i has bit j set if i is newer than j
+    RECENCY_PLRU,   // associativity - 1 tree bits pointing away from recent ways
+    RECENCY_RANDOM, // one fill count byte per row, then pseudo-random victims
+    RECENCY_FIFO,   // one next-victim byte per row
+    RECENCY_NRU,    // one referenced bit per way
+    RECENCY_SRRIP,  // 2-bit re-reference prediction per way, inserted at 2
+    RECENCY_BRRIP,  // as SRRIP, inserted at 3 except one fill in 32
+    RECENCY_OPT,    // Belady's policy over a window of upcoming references
+    RECENCY_INVALID
+};
+
+inline RecencyPolicy parseRecencyPolicy(const char* name)
+{
+    static const char* names[] = { "queue", "age", "matrix", "plru",
+        "random", "fifo", "nru", "srrip", "brrip", "opt" };
+    for (UINT32 i = 0; i < RECENCY_INVALID; i++)
+        if (strcmp(name, names[i]) == 0)
+            return (RecencyPolicy) i;
+    return RECENCY_INVALID;
+}
+
+// Returns a zeroed, CACHE_ALIGNMENT aligned array; free it through *alloc
+template <class T>
+T* alignedArray(size_t n, UINT8** alloc)
+{
+    *alloc = new UINT8[n * sizeof(T) + CACHE_ALIGNMENT]();
+    return (T*) (((size_t) *alloc + CACHE_ALIGNMENT - 1) & ~(size_t) (CACHE_ALIGNMENT - 1));
+}
+
+// Each policy below tracks the rows of one cache. A is the associativity
+// when it is known at compile time, or 0 to use the run-time value. Under
+// the exact-LRU policies, random, FIFO, NRU and SRRIP a row starts out
+// replacing way 0, then way 1 and so on, so empty ways fill in order.
+// TreePlru fills them in the order its tree points to, 0 4 2 6 1 5 3 7
+// for 8 ways. BRRIP inserts most lines already predicted distant, so a
+// new row keeps refilling way 0 until one of its rare near insertions.
+//
+//   touch(idx, j)   records a hit on way j of row idx
+//   insert(idx, j)  records a fill of way j of row idx
+//   victim(idx)     returns the way of row idx to replace next
+//
+// The LRU structures treat a fill as a touch.
+
+template <UINT32 A>
+class QueueLru
+{
+        UINT32  associativity;
+        UINT32* lruQ;
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        QueueLru(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            lruQ = new UINT32[(size_t) numRows * ways()];
+            for (UINT32 i = 0; i < numRows; i++)
+                for (UINT32 j = 0; j < ways(); j++)
+                    lruQ[(size_t) i * ways() + j] = j;
+        }
+        ~QueueLru()
+        {
+            delete[] lruQ;
+        }
+
+        // Pushes x_j to the very back of lruQ[idx]
+        void touch(UINT32 idx, UINT32 x_j) {
+            UINT32* q = lruQ + (size_t) idx * ways();
+            UINT32 j = 0;
+            while (q[j] != x_j)
+                j++;
+            while (j < ways() - 1) {
+                q[j] = q[j + 1];
+                j++;
+            }
+            q[ways() - 1] = x_j;
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        UINT32 victim(UINT32 idx) {
+            return lruQ[(size_t) idx * ways()];
+        }
+};
+
+template <UINT32 A>
+class AgeLru
+{
+        UINT32  associativity;
+        // Rows are padded to 16 ages; padding ages of 255 are never younger
+        // than a touched way and never the oldest
+        UINT32  ageStride;
+        UINT8*  age;
+        UINT8*  ageAlloc;
+
+        UINT32 ways() const { return A ? A : associativity; }
+        UINT32 stride() const { return A ? (A + 15) & ~15u : ageStride; }
+
+    public:
+        AgeLru(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() < 256);
+            ageStride = (ways() + 15) & ~15u;
+            age = alignedArray<UINT8>((size_t) numRows * stride(), &ageAlloc);
+            memset(age, 255, (size_t) numRows * stride());
+            for (UINT32 i = 0; i < numRows; i++)
+                for (UINT32 j = 0; j < ways(); j++)
+                    age[(size_t) i * stride() + j] = ways() - 1 - j;
+        }
+        ~AgeLru()
+        {
+            delete[] ageAlloc;
+        }
+
+        // Every way younger than x_j ages by one
+        void touch(UINT32 idx, UINT32 x_j) {
+            UINT8* row = age + (size_t) idx * stride();
+            UINT8 x_age = row[x_j];
+            if (x_age == 0)
+                return;
+#if defined(__SSE2__)
+            __m128i younger = _mm_set1_epi8((char) (x_age - 1));
+            for (UINT32 j = 0; j < stride(); j += 16) {
+                __m128i ages = _mm_load_si128((const __m128i*) (row + j));
+                __m128i inc = _mm_cmpeq_epi8(_mm_min_epu8(ages, younger), ages);
+                _mm_store_si128((__m128i*) (row + j), _mm_sub_epi8(ages, inc));
+            }
+#else
+            for (UINT32 j = 0; j < ways(); j++)
+                row[j] += row[j] < x_age;
+#endif
+            row[x_j] = 0;
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        UINT32 victim(UINT32 idx) {
+            const UINT8* row = age + (size_t) idx * stride();
+#if defined(__SSE2__)
+            __m128i oldest = _mm_set1_epi8((char) (ways() - 1));
+            for (UINT32 j = 0; ; j += 16) {
+                __m128i ages = _mm_load_si128((const __m128i*) (row + j));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(ages, oldest));
+                if (mask)
+                    return j + __builtin_ctz(mask);
+            }
+#else
+            UINT32 j = 0;
+            while (row[j] != ways() - 1)
+                j++;
+            return j;
+#endif
+        }
+};
+
+template <UINT32 A>
+class MatrixLru
+{
+        UINT32  associativity;
+        UINT64* matrix;
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        MatrixLru(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() <= 64);
+            matrix = new UINT64[(size_t) numRows * ways()]();
+            for (UINT32 i = 0; i < numRows; i++)
+                for (UINT32 j = 0; j < ways(); j++)
+                    touch(i, j);
+        }
+        ~MatrixLru()
+        {
+            delete[] matrix;
+        }
+
+        void touch(UINT32 idx, UINT32 x_j) {
+            UINT64* m = matrix + (size_t) idx * ways();
+            UINT64 all = ways() == 64 ? ~0ull : (1ull << ways()) - 1;
+            UINT64 column = ~(1ull << x_j);
+            for (UINT32 j = 0; j < ways(); j++)
+                m[j] &= column;
+            m[x_j] = all & column;
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        // The least recently used way is newer than no other way
+        UINT32 victim(UINT32 idx) {
+            const UINT64* m = matrix + (size_t) idx * ways();
+            UINT32 j = 0;
+            while (m[j])
+                j++;
+            return j;
+        }
+};
+
+template <UINT32 A>
+class TreePlru
+{
+        UINT32  associativity;
+        UINT64* tree;   // bit n set: the victim is in the right subtree of node n
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        TreePlru(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() <= 64 && (ways() & (ways() - 1)) == 0);
+            tree = new UINT64[numRows]();
+        }
+        ~TreePlru()
+        {
+            delete[] tree;
+        }
+
+        // Walk from the root, pointing each node away from x_j
+        void touch(UINT32 idx, UINT32 x_j) {
+            UINT64 bits = tree[idx];
+            UINT32 node = 1;
+            for (UINT32 half = ways() >> 1; half; half >>= 1) {
+                bool right = x_j & half;
+                if (right)
+                    bits &= ~(1ull << node);
+                else
+                    bits |= 1ull << node;
+                node = 2 * node + right;
+            }
+            tree[idx] = bits;
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        UINT32 victim(UINT32 idx) {
+            UINT64 bits = tree[idx];
+            UINT32 node = 1, j = 0;
+            for (UINT32 half = ways() >> 1; half; half >>= 1) {
+                bool right = (bits >> node) & 1;
+                j |= right ? half : 0;
+                node = 2 * node + right;
+            }
+            return j;
+        }
+};
+
+template <UINT32 A>
+class RandomReplacement
+{
+        UINT32  associativity;
+        UINT8*  filled;     // ways of each row filled so far
+        UINT32  state;      // LCG, seeded alike in every run
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        RandomReplacement(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() < 256);
+            filled = new UINT8[numRows]();
+            state = 1;
+        }
+        ~RandomReplacement()
+        {
+            delete[] filled;
+        }
+
+        void touch(UINT32 idx, UINT32 x_j) {
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            if (filled[idx] < ways())
+                filled[idx]++;
+        }
+        UINT32 victim(UINT32 idx) {
+            if (filled[idx] < ways())
+                return filled[idx];
+            state = state * 1664525u + 1013904223u;
+            return (UINT32) (((UINT64) (state >> 8) * ways()) >> 24);
+        }
+};
+
+template <UINT32 A>
+class FifoReplacement
+{
+        UINT32  associativity;
+        UINT8*  next;       // oldest fill of each row
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        FifoReplacement(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() <= 256);
+            next = new UINT8[numRows]();
+        }
+        ~FifoReplacement()
+        {
+            delete[] next;
+        }
+
+        void touch(UINT32 idx, UINT32 x_j) {
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            next[idx] = (UINT8) (x_j + 1 == ways() ? 0 : x_j + 1);
+        }
+        UINT32 victim(UINT32 idx) {
+            return next[idx];
+        }
+};
+
+template <UINT32 A>
+class NruReplacement
+{
+        UINT32  associativity;
+        UINT64* referenced; // bit j set: way j was used since the last reset
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        NruReplacement(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() <= 64);
+            referenced = new UINT64[numRows]();
+        }
+        ~NruReplacement()
+        {
+            delete[] referenced;
+        }
+
+        // Once every way is referenced only x_j stays marked, or none in a
+        // direct-mapped row, so victim() always finds a clear bit
+        void touch(UINT32 idx, UINT32 x_j) {
+            UINT64 all = ways() == 64 ? ~0ull : (1ull << ways()) - 1;
+            UINT64 bits = referenced[idx] | (1ull << x_j);
+            if (bits == all)
+                bits = ways() > 1 ? 1ull << x_j : 0;
+            referenced[idx] = bits;
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        UINT32 victim(UINT32 idx) {
+            return __builtin_ctzll(~referenced[idx]);
+        }
+};
+
+// Re-reference interval prediction (Jaleel et al., ISCA 2010). Each way has
+// a 2-bit prediction, packed 32 ways to a word: 0 on a hit, 2 (SRRIP) or
+// mostly 3 (BRRIP) on a fill. The victim is the first way predicted 3,
+// after ageing the whole row until one is.
+template <UINT32 A, bool BIMODAL>
+class RripReplacement
+{
+        UINT32  associativity;
+        UINT64* rrpv;
+        UINT32  fills;      // BRRIP inserts at 2 on every 32nd fill
+
+        UINT32 ways() const { return A ? A : associativity; }
+        UINT64 lowBits() const {
+            return 0x5555555555555555ull & (ways() == 32 ? ~0ull : (1ull << (2 * ways())) - 1);
+        }
+
+    public:
+        RripReplacement(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            assert (ways() <= 32);
+            rrpv = new UINT64[numRows];
+            for (UINT32 i = 0; i < numRows; i++)
+                rrpv[i] = lowBits() * 3;
+            fills = 0;
+        }
+        ~RripReplacement()
+        {
+            delete[] rrpv;
+        }
+
+        void touch(UINT32 idx, UINT32 x_j) {
+            rrpv[idx] &= ~(3ull << (2 * x_j));
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            UINT64 value = 2;
+            if (BIMODAL && (++fills & 31))
+                value = 3;
+            rrpv[idx] = (rrpv[idx] & ~(3ull << (2 * x_j))) | (value << (2 * x_j));
+        }
+        UINT32 victim(UINT32 idx) {
+            UINT64 bits = rrpv[idx];
+            UINT64 distant;
+            while (!(distant = bits & (bits >> 1) & lowBits()))
+                bits += lowBits();  // no field is 3, so no carries
+            rrpv[idx] = bits;
+            return __builtin_ctzll(distant) >> 1;
+        }
+};
+
+template <UINT32 A>
+class SrripReplacement: public RripReplacement<A, false>
+{
+    public:
+        SrripReplacement(UINT32 numRows, UINT32 associativityParam)
+            : RripReplacement<A, false>(numRows, associativityParam)
+        {
+        }
+};
+
+template <UINT32 A>
+class BrripReplacement: public RripReplacement<A, true>
+{
+    public:
+        BrripReplacement(UINT32 numRows, UINT32 associativityParam)
+            : RripReplacement<A, true>(numRows, associativityParam)
+        {
+        }
+};
+
+// Sliding window over the upcoming references of one simulator, giving
+// Belady's policy the position of the next reference to the current
+// reference's block. The window is kept for every block size a model
+// registers; positions are absolute reference numbers, and a block not
+// referenced again within the window is never reused as far as the policy
+// can tell. Each block size has a hash table from block to its latest
+// position, which drops entries that left the window when it is rebuilt.
+class NextUseWindow
+{
+        static const UINT32 MAX_GRANULARITIES = 4;
+        static const UINT64 NEVER = ~0ull;
+
+        struct Entry {
+            UINT32 block;   // ~0 when empty
+            UINT64 pos;
+        };
+
+        UINT32   size;
+        UINT32*  addrs;     // ring of pending references
+        bool*    writes;
+        UINT64   head;      // position of the oldest pending reference
+        UINT64   tail;      // position of the next reference pushed
+        UINT32   numGranularities;
+        UINT32   logBlockSizes[MAX_GRANULARITIES];
+        UINT64*  nextUse[MAX_GRANULARITIES];    // ring, parallel to addrs
+        Entry*   table[MAX_GRANULARITIES];
+        UINT32   tableMask;
+        UINT32   tableUsed[MAX_GRANULARITIES];
+        UINT64   current[MAX_GRANULARITIES];    // next uses of the popped reference
+
+        Entry* find(UINT32 g, UINT32 block) {
+            UINT32 i = (block * 2654435761u) & tableMask;
+            while (table[g][i].block != ~0u && table[g][i].block != block)
+                i = (i + 1) & tableMask;
+            return &table[g][i];
+        }
+
+        void rebuild(UINT32 g) {
+            Entry* old = table[g];
+            table[g] = new Entry[tableMask + 1];
+            memset(table[g], 0xff, (tableMask + 1) * sizeof(Entry));
+            tableUsed[g] = 0;
+            for (UINT32 i = 0; i <= tableMask; i++) {
+                if (old[i].block == ~0u || old[i].pos < head)
+                    continue;
+                *find(g, old[i].block) = old[i];
+                tableUsed[g]++;
+            }
+            delete[] old;
+        }
+
+    public:
+        NextUseWindow(UINT32 sizeParam)
+        {
+            size = sizeParam;
+            assert (size > 0);
+            addrs = new UINT32[size];
+            writes = new bool[size];
+            head = 0;
+            tail = 0;
+            numGranularities = 0;
+            tableMask = 1;
+            while (tableMask < 4 * size)
+                tableMask <<= 1;
+            tableMask--;
+        }
+        ~NextUseWindow()
+        {
+            delete[] addrs;
+            delete[] writes;
+            for (UINT32 g = 0; g < numGranularities; g++) {
+                delete[] nextUse[g];
+                delete[] table[g];
+            }
+        }
+
+        // Returns the slot of logBlockSize, registering it if needed
+        UINT32 addGranularity(UINT32 logBlockSize) {
+            for (UINT32 g = 0; g < numGranularities; g++)
+                if (logBlockSizes[g] == logBlockSize)
+                    return g;
+            assert (numGranularities < MAX_GRANULARITIES && head == tail);
+            UINT32 g = numGranularities++;
+            logBlockSizes[g] = logBlockSize;
+            nextUse[g] = new UINT64[size];
+            table[g] = new Entry[tableMask + 1];
+            memset(table[g], 0xff, (tableMask + 1) * sizeof(Entry));
+            tableUsed[g] = 0;
+            current[g] = NEVER;
+            return g;
+        }
+
+        bool full() {
+            return tail - head == size;
+        }
+        bool empty() {
+            return tail == head;
+        }
+
+        void push(UINT32 addr, bool isWrite) {
+            assert (!full());
+            UINT32 slot = (UINT32) (tail % size);
+            addrs[slot] = addr;
+            writes[slot] = isWrite;
+            for (UINT32 g = 0; g < numGranularities; g++) {
+                Entry* e = find(g, addr >> logBlockSizes[g]);
+                if (e->block == ~0u) {
+                    e->block = addr >> logBlockSizes[g];
+                    if (++tableUsed[g] * 2 > tableMask) {
+                        rebuild(g);
+                        e = find(g, addr >> logBlockSizes[g]);
+                        e->block = addr >> logBlockSizes[g];
+                        tableUsed[g]++;
+                    }
+                } else if (e->pos >= head)
+                    nextUse[g][e->pos % size] = tail;
+                e->pos = tail;
+                nextUse[g][slot] = NEVER;
+            }
+            tail++;
+        }
+
+        // Removes the oldest reference, making its next uses current
+        void pop(UINT32* addr, bool* isWrite) {
+            assert (!empty());
+            UINT32 slot = (UINT32) (head % size);
+            *addr = addrs[slot];
+            *isWrite = writes[slot];
+            for (UINT32 g = 0; g < numGranularities; g++)
+                current[g] = nextUse[g][slot];
+            head++;
+        }
+
+        UINT64 getNextUse(UINT32 g) {
+            return current[g];
+        }
+};
+
+// The window of the simulator using BeladyOpt, set by LookaheadSimulator
+// while it builds its models. The static of an inline function is one
+// object in the whole program, whichever files include this header.
+inline NextUseWindow*& currentNextUseWindow()
+{
+    static NextUseWindow* window = NULL;
+    return window;
+}
+
+// Belady's MIN: evicts the way whose block is next used furthest ahead, as
+// far as its window sees. Every way holds the position of its next use.
+template <UINT32 A>
+class BeladyOpt
+{
+        UINT32  associativity;
+        UINT64* nextUse;
+        NextUseWindow* window;
+        UINT32  granularity;    // window slot of this cache's block size
+
+        UINT32 ways() const { return A ? A : associativity; }
+
+    public:
+        BeladyOpt(UINT32 numRows, UINT32 associativityParam)
+        {
+            associativity = associativityParam;
+            nextUse = new UINT64[(size_t) numRows * ways()];
+            memset(nextUse, 0xff, (size_t) numRows * ways() * sizeof(UINT64));
+            window = NULL;
+            granularity = 0;
+        }
+        ~BeladyOpt()
+        {
+            delete[] nextUse;
+        }
+
+        void setLogBlockSize(UINT32 logBlockSize) {
+            window = currentNextUseWindow();
+            assert (window);
+            granularity = window->addGranularity(logBlockSize);
+        }
+
+        void touch(UINT32 idx, UINT32 x_j) {
+            nextUse[(size_t) idx * ways() + x_j] = window->getNextUse(granularity);
+        }
+        void insert(UINT32 idx, UINT32 x_j) {
+            touch(idx, x_j);
+        }
+        UINT32 victim(UINT32 idx) {
+            const UINT64* row = nextUse + (size_t) idx * ways();
+            UINT32 v = 0;
+            for (UINT32 j = 1; j < ways(); j++)
+                if (row[j] > row[v])
+                    v = j;
+            return v;
+        }
+};
+
+// Passes the block size to the policies that need it
+template <class P>
+struct PolicyBlockSize
+{
+    static void set(P& policy, UINT32 logBlockSize) { }
+};
+
+template <UINT32 A>
+struct PolicyBlockSize<BeladyOpt<A> >
+{
+    static void set(BeladyOpt<A>& policy, UINT32 logBlockSize) {
+        policy.setLogBlockSize(logBlockSize);
+    }
+};
+
+#endif
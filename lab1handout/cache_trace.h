@@ -0,0 +1,145 @@
+#ifndef CACHE_TRACE_H
+#define CACHE_TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "cache_types.h"
+
+// Binary trace of the reference stream seen by cacheLoad()/cacheStore().
+//
+// The file starts with the 8 byte magic below and is followed by one
+// LEB128 varint per reference. Addresses are word aligned before they reach
+// the models, so each record holds the zigzag-encoded difference between
+// this word address and the previous one, shifted left by one with the low
+// bit set for stores. Sequential and strided streams cost one byte per
+// reference.
+static const char TRACE_MAGIC[8] = {'L', '1', 'T', 'R', 'A', 'C', 'E', '1'};
+static const UINT32 TRACE_BUFFER_SIZE = 1u << 20;
+
+class TraceWriter
+{
+        FILE*   file;
+        UINT8*  buf;
+        UINT32  pos;
+        UINT32  prevWord;
+        UINT64  numRecords;
+
+        void flush() {
+            if (pos && fwrite(buf, 1, pos, file) != pos)
+                fprintf(stderr, "trace: short write\n");
+            pos = 0;
+        }
+
+    public:
+        TraceWriter() : file(NULL), buf(NULL), pos(0), prevWord(0), numRecords(0) { }
+
+        ~TraceWriter() {
+            close();
+        }
+
+        bool open(const char* path) {
+            file = fopen(path, "wb");
+            if (!file)
+                return false;
+            buf = new UINT8[TRACE_BUFFER_SIZE];
+            return fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), file) == sizeof(TRACE_MAGIC);
+        }
+
+        void record(UINT32 virtualAddr, bool isWrite) {
+            UINT32 word = virtualAddr >> 2;
+            INT32 delta = (INT32) (word - prevWord);
+            UINT32 zigzag = ((UINT32) delta << 1) ^ (UINT32) (delta >> 31);
+            UINT64 v = ((UINT64) zigzag << 1) | (isWrite ? 1 : 0);
+            prevWord = word;
+            numRecords++;
+
+            // A record is at most 5 bytes
+            if (pos + 5 > TRACE_BUFFER_SIZE)
+                flush();
+            while (v >= 0x80) {
+                buf[pos++] = (UINT8) (v | 0x80);
+                v >>= 7;
+            }
+            buf[pos++] = (UINT8) v;
+        }
+
+        UINT64 getNumRecords() {
+            return numRecords;
+        }
+
+        bool isOpen() {
+            return file != NULL;
+        }
+
+        void close() {
+            if (!file)
+                return;
+            flush();
+            fclose(file);
+            file = NULL;
+            delete[] buf;
+            buf = NULL;
+        }
+};
+
+class TraceReader
+{
+        FILE*   file;
+        UINT8*  buf;
+        UINT32  pos;
+        UINT32  len;
+        UINT32  prevWord;
+
+        // Refills the buffer, keeping any partial record at its tail
+        bool refill() {
+            UINT32 rest = len - pos;
+            memmove(buf, buf + pos, rest);
+            len = rest + (UINT32) fread(buf + rest, 1, TRACE_BUFFER_SIZE - rest, file);
+            pos = 0;
+            return len > rest;
+        }
+
+    public:
+        TraceReader() : file(NULL), buf(NULL), pos(0), len(0), prevWord(0) { }
+
+        ~TraceReader() {
+            if (file)
+                fclose(file);
+            delete[] buf;
+        }
+
+        bool open(const char* path) {
+            char magic[sizeof(TRACE_MAGIC)];
+            file = fopen(path, "rb");
+            if (!file)
+                return false;
+            buf = new UINT8[TRACE_BUFFER_SIZE];
+            return fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+        }
+
+        // Returns false at the end of the trace
+        bool next(UINT32* virtualAddr, bool* isWrite) {
+            if (len - pos < 5 && !refill() && pos == len)
+                return false;
+
+            UINT64 v = 0;
+            UINT32 shift = 0;
+            while (pos < len && (buf[pos] & 0x80)) {
+                v |= (UINT64) (buf[pos++] & 0x7f) << shift;
+                shift += 7;
+            }
+            if (pos == len)
+                return false; // truncated record
+            v |= (UINT64) buf[pos++] << shift;
+
+            UINT32 zigzag = (UINT32) (v >> 1);
+            INT32 delta = (INT32) (zigzag >> 1) ^ -(INT32) (zigzag & 1);
+            prevWord += (UINT32) delta;
+            *virtualAddr = prevWord << 2;
+            *isWrite = v & 1;
+            return true;
+        }
+};
+
+#endif
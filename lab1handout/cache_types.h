@@ -0,0 +1,17 @@
+#ifndef CACHE_TYPES_H
+#define CACHE_TYPES_H
+
+// The cache models are shared between the Pin tool and the standalone
+// drivers. Pin provides the fixed-width typedefs through pin.H; everywhere
+// else we supply the same names from <stdint.h>.
+#ifdef CACHES_STANDALONE
+#include <stdint.h>
+typedef uint8_t  UINT8;
+typedef uint32_t UINT32;
+typedef int32_t  INT32;
+typedef uint64_t UINT64;
+#else
+#include "pin.H"
+#endif
+
+#endif
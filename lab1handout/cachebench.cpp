@@ -0,0 +1,749 @@
+// Standalone regression and speed check for the lab1 cache models.
+//
+// Drives every configuration below over four synthetic reference streams
+// (sequential, strided, random and pointer-chase) and reports the
+// simulated accesses per second, without Pin or the SPEC binaries:
+//
+//   make check            # or ./cachebench [-n refs] [-g]
+//
+// Each run is checked, at any -n, against expectations that do not come
+// from the models themselves:
+//
+// - The exact-LRU configurations (age, queue, matrix) must match a
+//   brute-force LRU cache, for every model and stream.
+// - On the sequential stream, as long as it does not wrap around, the
+//   virtually-tagged cache and the TLB of every configuration miss once
+//   per block and page, on its first word, which is always a load.
+//
+// The feature runs then cover the write-policy hierarchy, context
+// switches, sampling, stack distances and reuse distances, each checked
+// against a plain model or a brute-force LRU cache as described with it.
+//
+// Finally the counters of every run and the reports of every feature run
+// are compared with the golden values in cachebench_golden.h, which only
+// catch drift and are only checked at the default -n. After an intended
+// change in behaviour, ./cachebench -g > cachebench_golden.h regenerates
+// them. The exit status is nonzero when any check fails.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "cache_models.h"
+
+// Declared by cache_models.h
+UINT32 logPageSize;
+UINT32 logPhysicalMemSize;
+
+static const UINT64 DEFAULT_REFS = 1000000;
+
+struct BenchConfig
+{
+    const char*   name;
+    UINT32        logNumRows;
+    UINT32        logBlockSize;
+    UINT32        associativity;
+    RecencyPolicy recency;
+    UINT32        tlbEntries;
+};
+
+static const BenchConfig configs[] = {
+    { "r10 b5 a2 age",          10, 5, 2,  RECENCY_AGE,    0 },
+    { "r10 b5 a1 queue",        10, 5, 1,  RECENCY_QUEUE,  0 },
+    { "r6 b6 a4 matrix",         6, 6, 4,  RECENCY_MATRIX, 0 },
+    { "r9 b5 a3 queue",          9, 5, 3,  RECENCY_QUEUE,  0 },
+    { "r12 b5 a8 plru",         12, 5, 8,  RECENCY_PLRU,   0 },
+    { "r6 b5 a16 age tlb64",     6, 5, 16, RECENCY_AGE,    64 },
+    { "r8 b5 a8 srrip",          8, 5, 8,  RECENCY_SRRIP,  0 },
+    { "r8 b5 a4 opt tlb16",      8, 5, 4,  RECENCY_OPT,    16 },
+    { "r10 b5 a1 nru",          10, 5, 1,  RECENCY_NRU,    0 },
+    { "r8 b5 a8 nru",            8, 5, 8,  RECENCY_NRU,    0 },
+    { "r8 b5 a4 random",         8, 5, 4,  RECENCY_RANDOM, 0 },
+    { "r9 b5 a3 fifo",           9, 5, 3,  RECENCY_FIFO,   0 },
+    { "r8 b5 a8 brrip",          8, 5, 8,  RECENCY_BRRIP,  0 },
+};
+static const UINT32 NUM_CONFIGS = sizeof(configs) / sizeof(configs[0]);
+
+enum Stream { STREAM_SEQUENTIAL, STREAM_STRIDED, STREAM_RANDOM, STREAM_CHASE, NUM_STREAMS };
+static const char* streamNames[NUM_STREAMS] = { "sequential", "strided", "random", "pointer-chase" };
+
+// Words in the region the sequential stream walks before wrapping around
+static const UINT64 SEQUENTIAL_WORDS = 1u<<20;
+
+// Every fourth reference of a stream is a store
+static bool isStore(UINT64 i)
+{
+    return i % 4 == 3;
+}
+
+// Counters of every model, in getCounters() order, for each stream and
+// config at DEFAULT_REFS references
+struct Golden
+{
+    UINT64 counters[MAX_MODELS][4];
+};
+
+// The feature runs below, also in the golden table
+enum Feature {
+    FEATURE_HIERARCHY, FEATURE_WRITE_THROUGH, FEATURE_SWITCH_FLUSH, FEATURE_SWITCH_TAGGED,
+    FEATURE_ASIDS, FEATURE_SAMPLING, FEATURE_STACK_DISTANCE, FEATURE_REUSE_DISTANCE, NUM_FEATURES
+};
+
+#include "cachebench_golden.h"
+
+// Deterministic 32 bit LCG, so the streams do not depend on the C library
+class Lcg
+{
+        UINT32 state;
+
+    public:
+        Lcg(UINT32 seed) : state(seed) { }
+
+        UINT32 next() {
+            state = state * 1664525u + 1013904223u;
+            return state;
+        }
+};
+
+// Fills addrs with n word-aligned references of the given stream
+static void makeStream(Stream stream, UINT64 n, UINT32* addrs)
+{
+    Lcg lcg(stream + 1);
+    switch (stream) {
+        case STREAM_SEQUENTIAL:
+            // 4MB region walked a word at a time
+            for (UINT64 i = 0; i < n; i++)
+                addrs[i] = 0x10000000u + (UINT32) ((i * 4) & (SEQUENTIAL_WORDS * 4 - 1));
+            break;
+        case STREAM_STRIDED:
+            // 1MB region walked with a 260 byte stride
+            for (UINT64 i = 0; i < n; i++)
+                addrs[i] = 0x20000000u + (UINT32) ((i * 260) % (1u<<20));
+            break;
+        case STREAM_RANDOM:
+            // uniform over 16MB
+            for (UINT64 i = 0; i < n; i++)
+                addrs[i] = 0x30000000u + ((lcg.next() >> 8) & ~3u);
+            break;
+        default: {
+            // one random cycle through 65536 nodes of 64 bytes
+            const UINT32 nodes = 1u<<16;
+            UINT32* order = new UINT32[nodes];
+            UINT32* succ = new UINT32[nodes];
+            for (UINT32 i = 0; i < nodes; i++)
+                order[i] = i;
+            for (UINT32 i = nodes - 1; i > 0; i--) {
+                UINT32 j = (lcg.next() >> 8) % (i + 1);
+                UINT32 t = order[i]; order[i] = order[j]; order[j] = t;
+            }
+            for (UINT32 i = 0; i < nodes; i++)
+                succ[order[i]] = order[(i + 1) % nodes];
+            UINT32 cur = order[0];
+            for (UINT64 i = 0; i < n; i++) {
+                addrs[i] = 0x40000000u + cur * 64;
+                cur = succ[cur];
+            }
+            delete[] order;
+            delete[] succ;
+        }
+    }
+}
+
+// Set-associative LRU cache kept as one list of keys per set, most
+// recently used first, written for obviousness rather than speed
+class ReferenceLru
+{
+        UINT32                            setMask;
+        UINT32                            associativity;
+        std::vector<std::vector<UINT32> > sets;
+
+    public:
+        ReferenceLru(UINT32 logNumSets, UINT32 associativityParam)
+            : setMask((1u<<logNumSets) - 1), associativity(associativityParam), sets(1u<<logNumSets)
+        {
+        }
+
+        // Looks up key in the set its low bits select, or in setIndex's
+        bool access(UINT32 key) {
+            return access(key, key);
+        }
+
+        bool access(UINT32 setIndex, UINT32 key) {
+            std::vector<UINT32>& set = sets[setIndex & setMask];
+            for (size_t i = 0; i < set.size(); i++) {
+                if (set[i] == key) {
+                    set.erase(set.begin() + i);
+                    set.insert(set.begin(), key);
+                    return true;
+                }
+            }
+            set.insert(set.begin(), key);
+            if (set.size() > associativity)
+                set.pop_back();
+            return false;
+        }
+};
+
+static void countRef(UINT64 counters[4], bool isWrite, bool isHit)
+{
+    counters[isWrite ? 1 : 0]++;
+    if (isHit)
+        counters[isWrite ? 3 : 2]++;
+}
+
+// Counters of the exact-LRU config c's models, from brute-force caches:
+// physical index and tag, virtual index with physical blocks, virtual
+// index and tag, and the TLB over virtual page numbers
+static void referenceCounters(const BenchConfig& c, const UINT32* addrs, UINT64 n, UINT64 expected[MAX_MODELS][4])
+{
+    memset(expected, 0, sizeof(UINT64) * MAX_MODELS * 4);
+    ReferenceLru pp(c.logNumRows, c.associativity);
+    ReferenceLru vp(c.logNumRows, c.associativity);
+    ReferenceLru vv(c.logNumRows, c.associativity);
+    CacheConfig defaults;
+    UINT32 tlbSets = c.tlbEntries / defaults.tlbAssociativity, logTlbSets = 0;
+    while ((2u<<logTlbSets) <= tlbSets)
+        logTlbSets++;
+    ReferenceLru tlb(logTlbSets, c.tlbEntries ? c.tlbEntries >> logTlbSets : 1);
+    for (UINT64 i = 0; i < n; i++) {
+        UINT32 virtualBlock = addrs[i] >> c.logBlockSize;
+        UINT32 physicalBlock = getPhysicalAddr(addrs[i]) >> c.logBlockSize;
+        countRef(expected[0], isStore(i), pp.access(physicalBlock));
+        countRef(expected[1], isStore(i), vp.access(virtualBlock, physicalBlock));
+        countRef(expected[2], isStore(i), vv.access(virtualBlock));
+        if (c.tlbEntries)
+            countRef(expected[3], isStore(i), tlb.access(addrs[i] >> logPageSize));
+    }
+}
+
+static bool isExactLru(RecencyPolicy recency)
+{
+    return recency == RECENCY_AGE || recency == RECENCY_QUEUE || recency == RECENCY_MATRIX;
+}
+
+// Every block and page of the sequential stream is first touched on its
+// first word, which holds no store since blocks are at least 4 words
+static void sequentialCounters(UINT32 logUnit, UINT64 n, UINT64 expected[4])
+{
+    UINT64 wordsPerUnit = 1ull << (logUnit - 2);
+    expected[0] = n - n / 4;
+    expected[1] = n / 4;
+    expected[2] = expected[0] - (n + wordsPerUnit - 1) / wordsPerUnit;
+    expected[3] = expected[1];
+}
+
+static bool sameCounters(const UINT64 a[4], const UINT64 b[4])
+{
+    for (UINT32 k = 0; k < 4; k++)
+        if (a[k] != b[k])
+            return false;
+    return true;
+}
+
+static void simulate(CacheSimulator* sim, const UINT32* addrs, UINT64 n)
+{
+    for (UINT64 i = 0; i < n; i++) {
+        if (isStore(i))
+            sim->store(sim, addrs[i]);
+        else
+            sim->load(sim, addrs[i]);
+    }
+}
+
+// Collects what a model's dumpResults() writes
+class Report
+{
+        char*  text;
+        size_t size;
+        FILE*  file;
+
+    public:
+        Report() : text(NULL), size(0)
+        {
+            file = open_memstream(&text, &size);
+        }
+        ~Report()
+        {
+            fclose(file);
+            free(text);
+        }
+
+        FILE* out() {
+            return file;
+        }
+
+        std::string str() {
+            fflush(file);
+            return std::string(text, size);
+        }
+};
+
+// Returns the rest of the line starting with label, or NULL
+static const char* findLine(const std::string& report, const std::string& label)
+{
+    size_t pos = report.compare(0, label.size(), label) == 0 ? 0 : report.find("\n" + label);
+    if (pos == std::string::npos)
+        return NULL;
+    return report.c_str() + pos + (pos ? 1 : 0) + label.size();
+}
+
+static bool scanCounters(const std::string& report, const std::string& label, UINT64 counters[4])
+{
+    const char* line = findLine(report, label);
+    return line && sscanf(line, "%lu,%lu,%lu,%lu", &counters[0], &counters[1], &counters[2], &counters[3]) == 4;
+}
+
+static bool scanPair(const std::string& report, const std::string& label, UINT64* a, UINT64* b)
+{
+    const char* line = findLine(report, label);
+    return line && sscanf(line, "%lu,%lu", a, b) == 2;
+}
+
+// Prints why a feature run failed its check and returns false
+static bool fail(const char* what)
+{
+    fprintf(stderr, "  %s\n", what);
+    return false;
+}
+
+static CacheConfig featureConfig()
+{
+    CacheConfig config;
+    config.logNumRows = 8;
+    config.logBlockSize = 5;
+    config.associativity = 4;
+    config.recency = RECENCY_AGE;
+    config.tlbEntries = 16;
+    return config;
+}
+
+// Write-back, write-allocate L1 over an L2 of larger blocks. The L1 must
+// count like the physically-indexed cache of the same geometry, and the
+// L2 must see one read per L1 miss and one write per written-back block.
+static bool runHierarchy(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    CacheConfig config = featureConfig();
+    config.hierarchy = true;
+    config.l2LogNumRows = 10;
+    config.l2LogBlockSize = 6;
+    config.l2Associativity = 8;
+    CacheSimulator* sim = makeCacheSimulator(config);
+    simulate(sim, addrs, n);
+    Report r;
+    sim->dumpResults(r.out());
+    delete sim;
+    *report = r.str();
+
+    UINT64 pp[4], l1[4], l2[4], fill, write;
+    if (!scanCounters(*report, "physical index physical tag: ", pp) || !scanCounters(*report, "hierarchy l1: ", l1) ||
+            !scanCounters(*report, "hierarchy l2: ", l2) ||
+            !scanPair(*report, "traffic l1-l2 bytes (fill,write): ", &fill, &write))
+        return fail("incomplete report");
+    if (!sameCounters(pp, l1))
+        return fail("l1 differs from the physical index physical tag cache");
+    UINT64 l1Misses = l1[0] + l1[1] - l1[2] - l1[3];
+    if (fill != l1Misses * 32 || l2[0] != l1Misses || l2[1] * 32 != write)
+        return fail("l2 requests differ from the l1 traffic");
+    return true;
+}
+
+// Write-through, no-write-allocate L1 alone: every store goes to memory
+// and only read misses fetch a block
+static bool runWriteThrough(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    CacheConfig config = featureConfig();
+    config.hierarchy = true;
+    config.writeBack = false;
+    config.writeAllocate = false;
+    CacheSimulator* sim = makeCacheSimulator(config);
+    simulate(sim, addrs, n);
+    Report r;
+    sim->dumpResults(r.out());
+    delete sim;
+    *report = r.str();
+
+    UINT64 l1[4], fill, write;
+    if (!scanCounters(*report, "hierarchy l1: ", l1) ||
+            !scanPair(*report, "traffic l1-memory bytes (fill,write): ", &fill, &write))
+        return fail("incomplete report");
+    if (write != l1[1] * 4 || fill != (l1[0] - l1[2]) * 32)
+        return fail("memory traffic differs from the l1 requests");
+    return true;
+}
+
+// Switches among asids address spaces every 10000 references. With a
+// single address space the physically-tagged caches, and with tagged
+// lines every model, must count as without the switches.
+static bool runContextSwitches(const UINT32* addrs, UINT64 n, UINT32 asids, bool tagged, std::string* report)
+{
+    const UINT64 switchRefs = 10000;
+    CacheConfig config = featureConfig();
+    CacheSimulator* base = makeCacheSimulator(config);
+    simulate(base, addrs, n);
+    UINT64 expected[MAX_MODELS][4];
+    base->getCounters(expected);
+    delete base;
+
+    config.contextSwitchRefs = switchRefs;
+    config.numAsids = asids;
+    config.asidTagged = tagged;
+    config.sharedPagePercent = asids > 1 ? 25 : 0;
+    config.trackSynonyms = asids > 1;
+    CacheSimulator* sim = makeCacheSimulator(config);
+    simulate(sim, addrs, n);
+    UINT64 counters[MAX_MODELS][4];
+    sim->getCounters(counters);
+    Report r;
+    sim->dumpResults(r.out());
+    delete sim;
+    *report = r.str();
+
+    const char* line = findLine(*report, "context switches: ");
+    UINT64 switches;
+    if (!line || sscanf(line, "%lu", &switches) != 1 || switches != n / switchRefs)
+        return fail("wrong number of context switches");
+    if (asids > 1)
+        return true;
+    for (UINT32 m = 0; m < MAX_MODELS; m++)
+        if ((tagged || m < 2) && !sameCounters(counters[m], expected[m]))
+            return fail("a model differs from the run without context switches");
+    return true;
+}
+
+static bool runSwitchFlush(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    return runContextSwitches(addrs, n, 1, false, report);
+}
+
+static bool runSwitchTagged(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    return runContextSwitches(addrs, n, 1, true, report);
+}
+
+static bool runAsids(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    return runContextSwitches(addrs, n, 4, true, report);
+}
+
+// Samples in replay's layout: skip 20000 references, warm up on 1000 and
+// measure 10000. One sample over the whole stream must give each model's
+// overall hit rate.
+static bool runSampling(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    const UINT64 warmup = 1000, measure = 10000, skip = 20000;
+    CacheConfig config = featureConfig();
+    CacheSimulator* sim = makeCacheSimulator(config);
+    SampledHitRates sampler;
+    UINT64 measureStart = skip + warmup + 1;
+    UINT64 samplePeriod = measureStart + measure - 1;
+    UINT64 samplePos = skip;
+    for (UINT64 i = 0; i < n; i++) {
+        if (++samplePos == measureStart)
+            sampler.begin(sim);
+        if (samplePos > skip) {
+            if (isStore(i))
+                sim->store(sim, addrs[i]);
+            else
+                sim->load(sim, addrs[i]);
+        }
+        if (samplePos == samplePeriod) {
+            sampler.end(sim);
+            samplePos = 0;
+        }
+    }
+    Report r;
+    sampler.dumpResults(r.out());
+    delete sim;
+    *report = r.str();
+
+    CacheSimulator* whole = makeCacheSimulator(config);
+    SampledHitRates once;
+    once.begin(whole);
+    simulate(whole, addrs, n);
+    once.end(whole);
+    UINT64 counters[MAX_MODELS][4];
+    UINT32 numModels = whole->getCounters(counters);
+    Report o;
+    once.dumpResults(o.out());
+    delete whole;
+    std::string expected;
+    for (UINT32 m = 0; m < numModels; m++) {
+        char line[256];
+        snprintf(line, sizeof(line), "sampled %s: 1,%f,%f\n", MODEL_NAMES[m],
+                (double) (counters[m][2] + counters[m][3]) / (counters[m][0] + counters[m][1]), 0.0);
+        expected += line;
+    }
+    if (o.str() != expected)
+        return fail("one sample differs from the overall hit rates");
+    return true;
+}
+
+// The hit matrix up to 2^10 rows and 8 ways of 32 byte blocks. Spot
+// points must match the three exact-LRU caches of that geometry,
+// including the virtually-indexed physically-tagged one above the page.
+static bool runStackDistance(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    const UINT32 maxLogNumRows = 10, maxAssociativity = 8;
+    StackDistanceModel phys(maxLogNumRows, 5, maxAssociativity);
+    StackDistanceModel virtPhys(maxLogNumRows, 5, maxAssociativity);
+    StackDistanceModel virt(maxLogNumRows, 5, maxAssociativity);
+    assert (stackDistanceNeedsVirtPhys(maxLogNumRows, 5));
+    for (UINT64 i = 0; i < n; i++) {
+        UINT32 physicalAddr = getPhysicalAddr(addrs[i]);
+        if (isStore(i)) {
+            phys.writeReq(physicalAddr);
+            virtPhys.writeReq(addrs[i], physicalAddr);
+            virt.writeReq(addrs[i]);
+        } else {
+            phys.readReq(physicalAddr);
+            virtPhys.readReq(addrs[i], physicalAddr);
+            virt.readReq(addrs[i]);
+        }
+    }
+    Report r;
+    dumpStackDistanceResults(r.out(), &phys, &virtPhys, &virt);
+    *report = r.str();
+
+    static const UINT32 points[][2] = { { 0, 8 }, { 4, 1 }, { 6, 4 }, { 8, 2 }, { 10, 8 } };
+    for (UINT32 p = 0; p < sizeof(points) / sizeof(points[0]); p++) {
+        CacheConfig config;
+        config.logNumRows = points[p][0];
+        config.logBlockSize = 5;
+        config.associativity = points[p][1];
+        config.recency = RECENCY_AGE;
+        CacheSimulator* sim = makeCacheSimulator(config);
+        simulate(sim, addrs, n);
+        UINT64 counters[MAX_MODELS][4];
+        sim->getCounters(counters);
+        delete sim;
+        for (UINT32 m = 0; m < 3; m++) {
+            char label[128];
+            snprintf(label, sizeof(label), "logNumRows %u associativity %u %s: ", points[p][0], points[p][1], MODEL_NAMES[m]);
+            UINT64 matrix[4];
+            if (!scanCounters(*report, label, matrix) || !sameCounters(matrix, counters[m]))
+                return fail("a stack distance point differs from its cache");
+        }
+    }
+    return true;
+}
+
+// Reuse distances of 32 byte lines with the working set every 100000
+// references. The misses of the fully-associative caches of 1, 16 and 256
+// lines must match brute-force LRU caches, and the cold references the
+// distinct lines.
+static bool runReuseDistance(const UINT32* addrs, UINT64 n, std::string* report)
+{
+    ReuseDistanceModel reuse(5, 100000);
+    for (UINT64 i = 0; i < n; i++) {
+        if (isStore(i))
+            reuse.writeReq(addrs[i]);
+        else
+            reuse.readReq(addrs[i]);
+    }
+    Report r;
+    reuse.dumpResults(r.out());
+    *report = r.str();
+
+    UINT64 readCold, writeCold;
+    if (!scanPair(*report, "cold: ", &readCold, &writeCold))
+        return fail("incomplete report");
+    UINT64 cold[2] = { 0, 0 };
+    std::set<UINT32> lines;
+    for (UINT64 i = 0; i < n; i++)
+        if (lines.insert(addrs[i] >> 5).second)
+            cold[isStore(i)]++;
+    if (readCold != cold[0] || writeCold != cold[1])
+        return fail("cold references differ from the distinct lines");
+
+    for (UINT32 logLines = 0; logLines <= 8; logLines += 4) {
+        ReferenceLru lru(0, 1u<<logLines);
+        UINT64 misses[2] = { 0, 0 };
+        for (UINT64 i = 0; i < n; i++)
+            if (!lru.access(addrs[i] >> 5))
+                misses[isStore(i)]++;
+        // The report stops at the longest distance seen, beyond which
+        // only the cold references miss
+        char label[32];
+        snprintf(label, sizeof(label), "%u,", 1u<<logLines);
+        UINT64 rm = readCold, wm = writeCold;
+        size_t curve = report->find("fully associative LRU misses");
+        if (curve == std::string::npos)
+            return fail("incomplete report");
+        const char* line = findLine(report->substr(curve), label);
+        if (line && sscanf(line, "%lu,%lu", &rm, &wm) != 2)
+            return fail("incomplete report");
+        if (rm != misses[0] || wm != misses[1])
+            return fail("a fully-associative miss count differs from its cache");
+    }
+    return true;
+}
+
+struct FeatureRun
+{
+    const char* name;
+    bool (*run)(const UINT32* addrs, UINT64 n, std::string* report);
+};
+
+static const FeatureRun features[NUM_FEATURES] = {
+    { "hierarchy l2 r10 b6 a8",   runHierarchy },
+    { "write-through no-alloc",   runWriteThrough },
+    { "switch flush 1 asid",      runSwitchFlush },
+    { "switch tagged 1 asid",     runSwitchTagged },
+    { "switch tagged 4 asids",    runAsids },
+    { "sampling",                 runSampling },
+    { "stack distance r10 a8",    runStackDistance },
+    { "reuse distance",           runReuseDistance },
+};
+
+// 64 bit FNV-1a, so the golden table holds one number per feature report
+static UINT64 hashReport(const std::string& report)
+{
+    UINT64 h = 14695981039346656037ull;
+    for (size_t i = 0; i < report.size(); i++) {
+        h ^= (UINT8) report[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-n refs] [-g]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    UINT64 numRefs = DEFAULT_REFS;
+    bool printGolden = false;
+    logPhysicalMemSize = 28;
+    logPageSize = 12;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:g")) != -1) {
+        switch (opt) {
+            case 'n': numRefs = strtoull(optarg, NULL, 0); break;
+            case 'g': printGolden = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (numRefs == 0)
+        usage(argv[0]);
+    bool checkGolden = numRefs == DEFAULT_REFS && !printGolden;
+
+    UINT32* addrs = new UINT32[numRefs];
+    UINT32 failures = 0;
+    UINT64 featureHashes[NUM_STREAMS][NUM_FEATURES];
+    if (printGolden)
+        printf("// Generated by ./cachebench -g, included by cachebench.cpp\n"
+                "static const Golden golden[NUM_STREAMS][NUM_CONFIGS] = {\n");
+    for (UINT32 s = 0; s < NUM_STREAMS; s++) {
+        makeStream((Stream) s, numRefs, addrs);
+        if (printGolden)
+            printf("    { // %s\n", streamNames[s]);
+        for (UINT32 c = 0; c < NUM_CONFIGS; c++) {
+            CacheConfig config;
+            config.logNumRows = configs[c].logNumRows;
+            config.logBlockSize = configs[c].logBlockSize;
+            config.associativity = configs[c].associativity;
+            config.recency = configs[c].recency;
+            config.tlbEntries = configs[c].tlbEntries;
+            CacheSimulator* sim = makeCacheSimulator(config);
+
+            double start = now();
+            simulate(sim, addrs, numRefs);
+            double elapsed = now() - start;
+
+            UINT64 counters[MAX_MODELS][4] = { { 0 } };
+            sim->getCounters(counters);
+            delete sim;
+
+            if (printGolden) {
+                printf("        { { ");
+                for (UINT32 m = 0; m < MAX_MODELS; m++)
+                    printf("{ %luu, %luu, %luu, %luu }%s", counters[m][0], counters[m][1],
+                            counters[m][2], counters[m][3], m + 1 < MAX_MODELS ? ", " : "");
+                printf(" } }, // %s\n", configs[c].name);
+                continue;
+            }
+
+            std::string checks;
+            bool ok = true;
+            if (isExactLru(configs[c].recency)) {
+                UINT64 expected[MAX_MODELS][4];
+                referenceCounters(configs[c], addrs, numRefs, expected);
+                for (UINT32 m = 0; m < MAX_MODELS; m++)
+                    ok = ok && sameCounters(counters[m], expected[m]);
+                checks += " lru";
+            }
+            if (s == STREAM_SEQUENTIAL && numRefs <= SEQUENTIAL_WORDS) {
+                UINT64 expected[4];
+                sequentialCounters(configs[c].logBlockSize, numRefs, expected);
+                ok = ok && sameCounters(counters[2], expected);
+                if (configs[c].tlbEntries) {
+                    sequentialCounters(logPageSize, numRefs, expected);
+                    ok = ok && sameCounters(counters[3], expected);
+                }
+                checks += " sequential";
+            }
+            if (checkGolden) {
+                for (UINT32 m = 0; m < MAX_MODELS; m++)
+                    ok = ok && sameCounters(counters[m], golden[s][c].counters[m]);
+                checks += " golden";
+            }
+            if (!ok)
+                failures++;
+            std::string status = checks.empty() ? "" : (ok ? "ok (" : "MISMATCH (") + checks.substr(1) + ")";
+            printf("%-14s %-22s %8.1f Maccesses/s %s\n", streamNames[s], configs[c].name,
+                    numRefs / elapsed / 1e6, status.c_str());
+        }
+        if (printGolden)
+            printf("    },\n");
+
+        for (UINT32 f = 0; f < NUM_FEATURES; f++) {
+            std::string report;
+            bool ok = features[f].run(addrs, numRefs, &report);
+            featureHashes[s][f] = hashReport(report);
+            if (printGolden)
+                continue;
+            if (!ok)
+                fprintf(stderr, "%s %s failed its check\n", streamNames[s], features[f].name);
+            if (checkGolden && featureHashes[s][f] != featureGolden[s][f]) {
+                fprintf(stderr, "%s %s report differs from the golden one:\n%s", streamNames[s], features[f].name,
+                        report.c_str());
+                ok = false;
+            }
+            if (!ok)
+                failures++;
+            printf("%-14s %-22s %s\n", streamNames[s], features[f].name, ok ? "ok" : "MISMATCH");
+        }
+    }
+    delete[] addrs;
+
+    if (printGolden) {
+        printf("};\n\n// FNV-1a hash of every feature report\n"
+                "static const UINT64 featureGolden[NUM_STREAMS][NUM_FEATURES] = {\n");
+        for (UINT32 s = 0; s < NUM_STREAMS; s++) {
+            printf("    { // %s\n", streamNames[s]);
+            for (UINT32 f = 0; f < NUM_FEATURES; f++)
+                printf("        0x%016lxull, // %s\n", featureHashes[s][f], features[f].name);
+            printf("    },\n");
+        }
+        printf("};\n");
+        return 0;
+    }
+
+    if (failures)
+        fprintf(stderr, "%u of %u runs failed their checks\n", failures, NUM_STREAMS * (NUM_CONFIGS + NUM_FEATURES));
+    return failures ? 1 : 0;
+}
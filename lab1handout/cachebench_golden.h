@@ -0,0 +1,107 @@
+// Generated by ./cachebench -g, included by cachebench.cpp
+static const Golden golden[NUM_STREAMS][NUM_CONFIGS] = {
+    { // sequential
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a2 age
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 queue
+        { { { 750000u, 250000u, 687500u, 250000u }, { 750000u, 250000u, 687500u, 250000u }, { 750000u, 250000u, 687500u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r6 b6 a4 matrix
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 queue
+        { { { 750000u, 250000u, 625256u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r12 b5 a8 plru
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 749023u, 250000u } } }, // r6 b5 a16 age tlb64
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 srrip
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 749023u, 250000u } } }, // r8 b5 a4 opt tlb16
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 nru
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 nru
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a4 random
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 fifo
+        { { { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 750000u, 250000u, 625000u, 250000u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 brrip
+    },
+    { // strided
+        { { { 750000u, 250000u, 52039u, 19939u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a2 age
+        { { { 750000u, 250000u, 8268u, 3892u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 queue
+        { { { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r6 b6 a4 matrix
+        { { { 750000u, 250000u, 1458u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 queue
+        { { { 750000u, 250000u, 675702u, 248992u }, { 750000u, 250000u, 718240u, 248992u }, { 750000u, 250000u, 718240u, 248992u }, { 0u, 0u, 0u, 0u } } }, // r12 b5 a8 plru
+        { { { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 702147u, 234376u } } }, // r6 b5 a16 age tlb64
+        { { { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 srrip
+        { { { 750000u, 250000u, 139662u, 65638u }, { 750000u, 250000u, 107088u, 106512u }, { 750000u, 250000u, 107088u, 106512u }, { 750000u, 250000u, 704422u, 235113u } } }, // r8 b5 a4 opt tlb16
+        { { { 750000u, 250000u, 8268u, 3892u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 nru
+        { { { 750000u, 250000u, 20777u, 8875u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 nru
+        { { { 750000u, 250000u, 11621u, 4809u }, { 750000u, 250000u, 11491u, 4660u }, { 750000u, 250000u, 11491u, 4660u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a4 random
+        { { { 750000u, 250000u, 3900u, 4u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 fifo
+        { { { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 brrip
+    },
+    { // random
+        { { { 750000u, 250000u, 3166u, 982u }, { 750000u, 250000u, 2985u, 951u }, { 750000u, 250000u, 2960u, 941u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a2 age
+        { { { 750000u, 250000u, 1551u, 500u }, { 750000u, 250000u, 1489u, 488u }, { 750000u, 250000u, 1476u, 483u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 queue
+        { { { 750000u, 250000u, 789u, 242u }, { 750000u, 250000u, 789u, 242u }, { 750000u, 250000u, 748u, 229u }, { 0u, 0u, 0u, 0u } } }, // r6 b6 a4 matrix
+        { { { 750000u, 250000u, 2371u, 730u }, { 750000u, 250000u, 2276u, 724u }, { 750000u, 250000u, 2246u, 712u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 queue
+        { { { 750000u, 250000u, 48645u, 16091u }, { 750000u, 250000u, 46201u, 15269u }, { 750000u, 250000u, 46115u, 15241u }, { 0u, 0u, 0u, 0u } } }, // r12 b5 a8 plru
+        { { { 750000u, 250000u, 1575u, 471u }, { 750000u, 250000u, 1575u, 471u }, { 750000u, 250000u, 1492u, 443u }, { 750000u, 250000u, 11897u, 3841u } } }, // r6 b5 a16 age tlb64
+        { { { 750000u, 250000u, 3118u, 977u }, { 750000u, 250000u, 3053u, 962u }, { 750000u, 250000u, 2958u, 936u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 srrip
+        { { { 750000u, 250000u, 29577u, 9699u }, { 750000u, 250000u, 29597u, 9684u }, { 750000u, 250000u, 29574u, 9673u }, { 750000u, 250000u, 42505u, 13920u } } }, // r8 b5 a4 opt tlb16
+        { { { 750000u, 250000u, 1551u, 500u }, { 750000u, 250000u, 1489u, 488u }, { 750000u, 250000u, 1476u, 483u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 nru
+        { { { 750000u, 250000u, 3120u, 991u }, { 750000u, 250000u, 3044u, 946u }, { 750000u, 250000u, 2950u, 919u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 nru
+        { { { 750000u, 250000u, 1587u, 474u }, { 750000u, 250000u, 1580u, 460u }, { 750000u, 250000u, 1504u, 442u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a4 random
+        { { { 750000u, 250000u, 2374u, 730u }, { 750000u, 250000u, 2278u, 726u }, { 750000u, 250000u, 2248u, 714u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 fifo
+        { { { 750000u, 250000u, 3056u, 1061u }, { 750000u, 250000u, 2872u, 940u }, { 750000u, 250000u, 2803u, 876u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 brrip
+    },
+    { // pointer-chase
+        { { { 750000u, 250000u, 228u, 15u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a2 age
+        { { { 750000u, 250000u, 122u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 queue
+        { { { 750000u, 250000u, 46u, 0u }, { 750000u, 250000u, 46u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r6 b6 a4 matrix
+        { { { 750000u, 250000u, 153u, 0u }, { 750000u, 250000u, 45u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 queue
+        { { { 750000u, 250000u, 2781u, 813u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r12 b5 a8 plru
+        { { { 750000u, 250000u, 91u, 15u }, { 750000u, 250000u, 91u, 15u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 46804u, 14947u } } }, // r6 b5 a16 age tlb64
+        { { { 750000u, 250000u, 198u, 30u }, { 750000u, 250000u, 105u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 srrip
+        { { { 750000u, 250000u, 4369u, 1456u }, { 750000u, 250000u, 4360u, 1415u }, { 750000u, 250000u, 4341u, 1419u }, { 750000u, 250000u, 85372u, 27513u } } }, // r8 b5 a4 opt tlb16
+        { { { 750000u, 250000u, 122u, 0u }, { 750000u, 250000u, 0u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r10 b5 a1 nru
+        { { { 750000u, 250000u, 177u, 39u }, { 750000u, 250000u, 95u, 5u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 nru
+        { { { 750000u, 250000u, 95u, 8u }, { 750000u, 250000u, 52u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a4 random
+        { { { 750000u, 250000u, 153u, 0u }, { 750000u, 250000u, 45u, 0u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r9 b5 a3 fifo
+        { { { 750000u, 250000u, 1390u, 485u }, { 750000u, 250000u, 561u, 180u }, { 750000u, 250000u, 0u, 0u }, { 0u, 0u, 0u, 0u } } }, // r8 b5 a8 brrip
+    },
+};
+
+// FNV-1a hash of every feature report
+static const UINT64 featureGolden[NUM_STREAMS][NUM_FEATURES] = {
+    { // sequential
+        0x66a3cbdb67f3630dull, // hierarchy l2 r10 b6 a8
+        0x68450af6b2d4f066ull, // write-through no-alloc
+        0xedaf4876b384037full, // switch flush 1 asid
+        0x272b334a5621c825ull, // switch tagged 1 asid
+        0xb174ee6e055c0456ull, // switch tagged 4 asids
+        0x715e4e1d23291be7ull, // sampling
+        0x0ccdba2e1a3b6db5ull, // stack distance r10 a8
+        0xb344e338add450f1ull, // reuse distance
+    },
+    { // strided
+        0x18cfedcec5b6cd0aull, // hierarchy l2 r10 b6 a8
+        0x58d3ba974765d6d0ull, // write-through no-alloc
+        0xcb4396aa7bedc26full, // switch flush 1 asid
+        0xcda34bacf279bd93ull, // switch tagged 1 asid
+        0x00660cc3e41a873dull, // switch tagged 4 asids
+        0xc8cb4c3908edca62ull, // sampling
+        0x9beddad135c02bbeull, // stack distance r10 a8
+        0xe21f06715de03b15ull, // reuse distance
+    },
+    { // random
+        0x0b9560eef0da1f92ull, // hierarchy l2 r10 b6 a8
+        0xb79ff33b46e28b1cull, // write-through no-alloc
+        0x4a4bd1e6ebdc430dull, // switch flush 1 asid
+        0xd768077f74cc5801ull, // switch tagged 1 asid
+        0x809c58143e6b25d9ull, // switch tagged 4 asids
+        0x0789a8f0d174c458ull, // sampling
+        0xd4e0def5d3eb0221ull, // stack distance r10 a8
+        0xdf8e634f4e838fbdull, // reuse distance
+    },
+    { // pointer-chase
+        0xf4a5fe65e1a23252ull, // hierarchy l2 r10 b6 a8
+        0x7cc9204348dadb18ull, // write-through no-alloc
+        0x4e83165cbad642a4ull, // switch flush 1 asid
+        0x89595fddd31979baull, // switch tagged 1 asid
+        0x696a4bcf5d8ca7b1ull, // switch tagged 4 asids
+        0x209ce949d9b2134cull, // sampling
+        0xa3993b9ccda9b1a6ull, // stack distance r10 a8
+        0x73cecb89cccf313aull, // reuse distance
+    },
+};
@@ -1,320 +1,248 @@
 #include <iostream>
+#include <map>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
 #include <math.h>
 #include "pin.H"
+#include "cache_models.h"
+#include "cache_trace.h"
 
-#define DEBUG 0
-
+// Declared by cache_models.h
 UINT32 logPageSize;
 UINT32 logPhysicalMemSize;
 
-//Function to obtain physical page number given a virtual page number
-UINT32 getPhysicalPageNumber(UINT32 virtualPageNumber)
+// The three models, specialized for the -lru and -a knobs
+CacheConfig cacheConfig;
+CacheSimulator* cacheSim;
+TraceWriter traceWriter;
+StackDistanceModel* stackDistPhys;
+StackDistanceModel* stackDistVirtPhys;
+StackDistanceModel* stackDistVirt;
+ReuseDistanceModel* reuseDist;
+// Per-thread reference buffer used with -buf, BUFFER_ID_INVALID otherwise
+BUFFER_ID refBuffer = BUFFER_ID_INVALID;
+
+// With -mt every thread simulates its own private models. Slots are
+// indexed by THREADID and padded to a host cache line so threads never
+// share one; the trace writer, stack distance and reuse distance models
+// stay shared and are updated under sharedLock.
+static const UINT32 MAX_THREADS = 256;
+struct ThreadSlot
 {
-    INT32 key = (INT32) virtualPageNumber;
-    key = ~key + (key << 15); // key = (key << 15) - key - 1;
-    key = key ^ (key >> 12);
-    key = key + (key << 2);
-    key = key ^ (key >> 4);
-    key = key * 2057; // key = (key + (key << 3)) + (key << 11);
-    key = key ^ (key >> 16);
-    return (UINT32) (key&(((UINT32)(~0))>>(32-(logPhysicalMemSize-logPageSize))));
-}
+    CacheSimulator* sim;
+    UINT8 pad[CACHE_ALIGNMENT - sizeof(CacheSimulator*)];
+} __attribute__((aligned(CACHE_ALIGNMENT)));
+ThreadSlot threadSlots[MAX_THREADS];
+UINT32 numThreads = 0;
+bool perThread = false;
+PIN_LOCK sharedLock;
+
+// With -sm every period of references is sampleWarmup references simulated
+// to warm the models, sampleMeasure references simulated and measured, then
+// sampleSkip references that only advance samplePos. samplePos counts the
+// references of the current period and starts at sampleSkip so the first
+// period begins with warmup.
+SampledHitRates sampler;
+UINT64 sampleSkip = 0;
+UINT64 sampleMeasureStart = 0;  // position of the first measured reference
+UINT64 samplePeriod = 0;
+UINT64 samplePos = 0;
+// With -pc every simulator charges its misses to the instruction in its
+// pcTable. Images may be unloaded before Fini, so each memory
+// instruction's image and routine are resolved when it is instrumented.
+bool pcReport = false;
+std::map<ADDRINT, string> pcNames;
+/*UINT64 numMisalignedLoads = 0;
+UINT64 numMisalignedStores = 0;
+UINT32 lowestPhysicalAddr = -1;
+UINT32 highestPhysicalAddr = 0;
+UINT32 lowestVirtualAddr = -1;
+UINT32 highestVirtualAddr= 0;*/
 
-class CacheModel
+//Trace capture analysis routine
+void traceLoad(UINT32 virtualAddr)
 {
-    protected:
-        UINT32   logNumRows;
-        UINT32   logBlockSize;
-        UINT32   associativity;
-        UINT64   readReqs;
-        UINT64   writeReqs;
-        UINT64   readHits;
-        UINT64   writeHits;
-        UINT32** tag;
-        bool**   validBit;
-        UINT32** lruQ;
-
-    public:
-        //Constructor for a cache
-        CacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
-        {
-            logNumRows = logNumRowsParam;
-            logBlockSize = logBlockSizeParam;
-            associativity = associativityParam;
-            readReqs = 0;
-            writeReqs = 0;
-            readHits = 0;
-            writeHits = 0;
-            tag = new UINT32*[1u<<logNumRows];
-            validBit = new bool*[1u<<logNumRows];
-            lruQ = new UINT32*[1u<<logNumRows];
-            for(UINT32 i = 0; i < 1u<<logNumRows; i++)
-            {
-                tag[i] = new UINT32[associativity];
-                validBit[i] = new bool[associativity];
-                lruQ[i] = new UINT32[associativity];
-                for(UINT32 j = 0; j < associativity; j++) {
-                    validBit[i][j] = false;
-                    lruQ[i][j] = j;
-                }
-            }
-        }
-        // Destructor
-        virtual ~CacheModel()
-        {
-            for(UINT32 i = 0; i < (1U<<logNumRows); i++)
-            {
-                delete[] tag[i];
-                delete[] validBit[i];
-                delete[] lruQ[i];
-            }
-            delete[] tag;
-            delete[] validBit;
-            delete[] lruQ;
-        }
-
-        //Call this function to update the cache state whenever data is read
-        virtual void readReq(UINT32 virtualAddr) = 0;
-
-        //Call this function to update the cache state whenever data is written
-        virtual void writeReq(UINT32 virtualAddr) = 0;
-
-        bool searchAddr(UINT32 addr, UINT32* r_j) {
-            UINT32 x_tag = getTag(addr), x_idx = getIdx(addr);
-            for(UINT32 j = 0; j < associativity; j++) {
-                if (validBit[x_idx][j] && tag[x_idx][j] == x_tag) {
-                    *r_j = j; return true;
-                }
-            }
-            return false;
-        }
+    traceWriter.record((virtualAddr >> 2) << 2, false);
+}
 
-        UINT32 getPageNumber(UINT32 addr) {
-            return addr >> logPageSize;
-        }
-        UINT32 getPageOffset(UINT32 addr) {
-            return addr & ((1u<<logPageSize)-1);
-        }
-        UINT32 getTag(UINT32 addr) {
-            return addr >> (logBlockSize + logNumRows);
-        }
-        UINT32 getIdx(UINT32 addr) {
-            return (addr >> logBlockSize) & ((1u<<logNumRows)-1);
-        }
-        UINT32 getOffset(UINT32 addr) {
-            return addr & ((1u<<logBlockSize)-1);
-        }
+//Trace capture analysis routine
+void traceStore(UINT32 virtualAddr)
+{
+    traceWriter.record((virtualAddr >> 2) << 2, true);
+}
 
-        // Make address from tag, idx and offset
-        UINT32 makeAddr(UINT32 tag, UINT32 idx, UINT32 offset) {
-            assert (idx < (1u<<logNumRows));
-            assert (offset < (1u<<logBlockSize));
+//Stack distance analysis routine
+void stackDistanceLoad(UINT32 virtualAddr)
+{
+    virtualAddr = (virtualAddr >> 2) << 2;
+    UINT32 physicalAddr = getPhysicalAddr(virtualAddr);
+    stackDistPhys->readReq(physicalAddr);
+    if (stackDistVirtPhys)
+        stackDistVirtPhys->readReq(virtualAddr, physicalAddr);
+    stackDistVirt->readReq(virtualAddr);
+}
 
-            return (tag << (logBlockSize + logNumRows)) | (idx << logBlockSize) | offset;
-        }
-        // Make address from ppn and offset
-        UINT32 makeAddr(UINT32 pageNumber, UINT32 pageOffset) {
-            assert (pageOffset < (1u<<logPageSize));
+//Stack distance analysis routine
+void stackDistanceStore(UINT32 virtualAddr)
+{
+    virtualAddr = (virtualAddr >> 2) << 2;
+    UINT32 physicalAddr = getPhysicalAddr(virtualAddr);
+    stackDistPhys->writeReq(physicalAddr);
+    if (stackDistVirtPhys)
+        stackDistVirtPhys->writeReq(virtualAddr, physicalAddr);
+    stackDistVirt->writeReq(virtualAddr);
+}
 
-            return (pageNumber << logPageSize) | pageOffset;
-        }
+//Reuse distance analysis routine
+void reuseDistanceLoad(UINT32 virtualAddr)
+{
+    reuseDist->readReq((virtualAddr >> 2) << 2);
+}
 
-        // Pushes x_j to the very back of lruQ[idx] 
-        UINT32 lruTouch(UINT32 idx, UINT32 x_j) {
-            assert (idx < (1u<<logNumRows));
-            assert (x_j < associativity);
-
-            UINT32 j = 0;
-            while (lruQ[idx][j] != x_j) {
-                if (DEBUG)  printf("%d %d %d\n", j, x_j, lruQ[idx][j] );
-                j++;
-            }
-            while (j < associativity - 1) {
-                lruQ[idx][j] = lruQ[idx][j + 1];
-                j++;
-            }
-            lruQ[idx][associativity - 1] = x_j;
-        }
-        UINT32 lruHead(UINT32 idx) {
-            return lruQ[idx][0];
-        }
+//Reuse distance analysis routine
+void reuseDistanceStore(UINT32 virtualAddr)
+{
+    reuseDist->writeReq((virtualAddr >> 2) << 2);
+}
 
-        //Do not modify this function
-        void dumpResults(FILE* outFile)
-        {
-            fprintf(outFile, "%lu,%lu,%lu,%lu\n", readReqs, writeReqs, readHits, writeHits);
-        }
-};
+//Per-thread cache analysis routine
+void threadLoad(THREADID tid, UINT32 virtualAddr)
+{
+    CacheSimulator* sim = threadSlots[tid].sim;
+    sim->load(sim, virtualAddr);
+}
 
-CacheModel* cachePP;
-CacheModel* cacheVP;
-CacheModel* cacheVV;
-/*UINT64 numMisalignedLoads = 0;
-UINT64 numMisalignedStores = 0;
-UINT32 lowestPhysicalAddr = -1;
-UINT32 highestPhysicalAddr = 0;
-UINT32 lowestVirtualAddr = -1;
-UINT32 highestVirtualAddr= 0;*/
+//Per-thread cache analysis routine
+void threadStore(THREADID tid, UINT32 virtualAddr)
+{
+    CacheSimulator* sim = threadSlots[tid].sim;
+    sim->store(sim, virtualAddr);
+}
 
-class LruPhysIndexPhysTagCacheModel: public CacheModel
+//Per-instruction miss attribution analysis routines
+void threadLoadPc(THREADID tid, ADDRINT pc, UINT32 virtualAddr)
 {
-    public:
-        LruPhysIndexPhysTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
-            : CacheModel(logNumRowsParam, logBlockSizeParam, associativityParam)
-        {
-        }
+    CacheSimulator* sim = threadSlots[tid].sim;
+    sim->loadPc(sim, pc, virtualAddr);
+}
 
-        bool access(UINT32 virtualAddr) {
-            UINT32 physicalAddr = makeAddr(getPhysicalPageNumber(getPageNumber(virtualAddr)), getPageOffset(virtualAddr));
-
-
-            //if (physicalAddr > highestPhysicalAddr) highestPhysicalAddr = virtualAddr;
-            //if (physicalAddr < lowestPhysicalAddr) lowestPhysicalAddr = virtualAddr;
-
-
-            UINT32 idx = getIdx(physicalAddr), j;
-            if (DEBUG) printf("Searching %x in cache\n", physicalAddr);
-            bool isHit = searchAddr(physicalAddr, &j);
-            if (isHit) {
-                if (DEBUG) printf("Got hit, updating metadata\n");
-                lruTouch(idx, j);
-                if (DEBUG) printf("Access (HIT) successful\n");
-                return true;
-            }
-            if (DEBUG) printf("Got miss, updating metadata\n");
-            UINT32 lru_j = lruHead(idx);
-            tag[idx][lru_j] = getTag(physicalAddr);
-            validBit[idx][lru_j] = true;
-            if (DEBUG) printf("Updating lruQ\n");
-            lruTouch(idx, lru_j);
-            if (DEBUG) printf("Access (MISS) successful\n");
-            return false;
-        }
+void threadStorePc(THREADID tid, ADDRINT pc, UINT32 virtualAddr)
+{
+    CacheSimulator* sim = threadSlots[tid].sim;
+    sim->storePc(sim, pc, virtualAddr);
+}
 
-        void readReq(UINT32 virtualAddr)
-        {
-            readReqs++;
-            if (access(virtualAddr))
-                readHits++;
-        }
+//Sampling predicate, simple enough for Pin to inline: returns nonzero
+//outside the skipped references
+ADDRINT PIN_FAST_ANALYSIS_CALL sampleDetailed()
+{
+    return ++samplePos > sampleSkip;
+}
 
-        void writeReq(UINT32 virtualAddr)
-        {
-            writeReqs++;
-            if (access(virtualAddr))
-                writeHits++;
-        }
-};
+//Sampled cache analysis routine, called when sampleDetailed() holds
+void sampledAccess(UINT32 virtualAddr, BOOL isWrite)
+{
+    if (samplePos == sampleMeasureStart)
+        sampler.begin(cacheSim);
+    if (isWrite)
+        cacheSim->store(cacheSim, virtualAddr);
+    else
+        cacheSim->load(cacheSim, virtualAddr);
+    if (samplePos == samplePeriod) {
+        sampler.end(cacheSim);
+        samplePos = 0;
+    }
+}
 
-class LruVirIndexPhysTagCacheModel: public CacheModel
+//Shared analysis routines under -mt. Trace capture always goes through
+//them, as the writer's buffer takes one thread at a time.
+void lockedTraceLoad(THREADID tid, UINT32 virtualAddr)
 {
-    public:
-        LruVirIndexPhysTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
-            : CacheModel(logNumRowsParam, logBlockSizeParam, associativityParam)
-        {
-           // printf("%d %d %d %d", logBlockSizeParam, logNumRows, logPageSize, associativity);
-           // assert (logBlockSize + logNumRows < logPageSize && associativity == 1 ||
-           //         logBlockSize + logNumRows == logPageSize);
-        }
+    PIN_GetLock(&sharedLock, tid + 1);
+    traceLoad(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-        bool access(UINT32 virtualAddr) {
-            UINT32 physicalAddr = makeAddr(getPhysicalPageNumber(getPageNumber(virtualAddr)), getPageOffset(virtualAddr));
-            UINT32 idx = getIdx(virtualAddr), j;
-            UINT32 effectiveAddr = ((physicalAddr >> (logNumRows+logBlockSize)) << (logNumRows+logBlockSize)) | (virtualAddr & ((1u<<(logNumRows+logBlockSize))-1));
-            bool isHit = searchAddr(effectiveAddr, &j);
-            if (isHit) {
-                lruTouch(idx, j);
-                return true;
-            }
-            UINT32 lru_j = lruHead(idx);
-            tag[idx][lru_j] = getTag(effectiveAddr);
-            validBit[idx][lru_j] = true;
-            lruTouch(idx, lru_j);
-            return false;
-        }
+void lockedTraceStore(THREADID tid, UINT32 virtualAddr)
+{
+    PIN_GetLock(&sharedLock, tid + 1);
+    traceStore(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-        void readReq(UINT32 virtualAddr)
-        {
-            if (logBlockSize + logNumRows > logPageSize) return;
-            readReqs++;
-            if (access(virtualAddr))
-                readHits++;
-        }
+void lockedStackDistanceLoad(THREADID tid, UINT32 virtualAddr)
+{
+    PIN_GetLock(&sharedLock, tid + 1);
+    stackDistanceLoad(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-        void writeReq(UINT32 virtualAddr)
-        {
-            if (logBlockSize + logNumRows > logPageSize) return;
-            writeReqs++;
-            if (access(virtualAddr))
-                writeHits++;
-        }
-};
+void lockedStackDistanceStore(THREADID tid, UINT32 virtualAddr)
+{
+    PIN_GetLock(&sharedLock, tid + 1);
+    stackDistanceStore(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-class LruVirIndexVirTagCacheModel: public CacheModel
+void lockedReuseDistanceLoad(THREADID tid, UINT32 virtualAddr)
 {
-    public:
-        LruVirIndexVirTagCacheModel(UINT32 logNumRowsParam, UINT32 logBlockSizeParam, UINT32 associativityParam)
-            : CacheModel(logNumRowsParam, logBlockSizeParam, associativityParam)
-        {
-        }
+    PIN_GetLock(&sharedLock, tid + 1);
+    reuseDistanceLoad(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-        bool access(UINT32 virtualAddr) {
-            UINT32 idx = getIdx(virtualAddr), j;
-            bool isHit = searchAddr(virtualAddr, &j);
-            if (isHit) {
-                lruTouch(idx, j);
-                return true;
-            }
-            UINT32 lru_j = lruHead(idx);
-            tag[idx][lru_j] = getTag(virtualAddr);
-            validBit[idx][lru_j] = true;
-            lruTouch(idx, lru_j);
-            return false;
-        }
+void lockedReuseDistanceStore(THREADID tid, UINT32 virtualAddr)
+{
+    PIN_GetLock(&sharedLock, tid + 1);
+    reuseDistanceStore(virtualAddr);
+    PIN_ReleaseLock(&sharedLock);
+}
 
-        void readReq(UINT32 virtualAddr)
-        {
-            readReqs++;
-            if (access(virtualAddr))
-                readHits++;
+// Pin calls this function when a thread's reference buffer fills up and
+// when the thread exits, with the references in program order
+VOID* BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf, UINT64 numElements, VOID *v)
+{
+    const MemRef* refs = (const MemRef*) buf;
+    CacheSimulator* sim = perThread ? threadSlots[tid].sim : cacheSim;
+    if (perThread)
+        PIN_GetLock(&sharedLock, tid + 1);
+    if (traceWriter.isOpen())
+        for (UINT64 i = 0; i < numElements; i++)
+            traceWriter.record(((UINT32) refs[i].virtualAddr >> 2) << 2, refs[i].isWrite);
+    if (stackDistPhys) {
+        for (UINT64 i = 0; i < numElements; i++) {
+            if (refs[i].isWrite)
+                stackDistanceStore((UINT32) refs[i].virtualAddr);
+            else
+                stackDistanceLoad((UINT32) refs[i].virtualAddr);
         }
-
-        void writeReq(UINT32 virtualAddr)
-        {
-            writeReqs++;
-            if (access(virtualAddr))
-                writeHits++;
+    }
+    if (reuseDist) {
+        for (UINT64 i = 0; i < numElements; i++) {
+            if (refs[i].isWrite)
+                reuseDistanceStore((UINT32) refs[i].virtualAddr);
+            else
+                reuseDistanceLoad((UINT32) refs[i].virtualAddr);
         }
-};
-
-//Cache analysis routine
-void cacheLoad(UINT32 virtualAddr)
-{
-    //Here the virtual address is aligned to a word boundary
-    //if (virtualAddr & 0x3)
-    //    numMisalignedLoads++;
-    //if (virtualAddr > highestVirtualAddr) highestVirtualAddr = virtualAddr;
-    //if (virtualAddr < lowestVirtualAddr) lowestVirtualAddr = virtualAddr;
-    virtualAddr = (virtualAddr >> 2) << 2;
-    cachePP->readReq(virtualAddr);
-    cacheVP->readReq(virtualAddr);
-    cacheVV->readReq(virtualAddr);
+    }
+    if (perThread)
+        PIN_ReleaseLock(&sharedLock);
+    sim->batch(sim, refs, numElements);
+    return buf;
 }
 
-//Cache analysis routine
-void cacheStore(UINT32 virtualAddr)
+// Pin calls this function when a thread starts, before it runs any
+// analysis routine
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
 {
-    //if (virtualAddr & 0x3)
-    //    numMisalignedStores++;
-    //if (virtualAddr > highestVirtualAddr) highestVirtualAddr = virtualAddr;
-    //if (virtualAddr < lowestVirtualAddr) lowestVirtualAddr = virtualAddr;
-    //Here the virtual address is aligned to a word boundary
-    virtualAddr = (virtualAddr >> 2) << 2;
-    cachePP->writeReq(virtualAddr);
-    cacheVP->writeReq(virtualAddr);
-    cacheVV->writeReq(virtualAddr);
+    assert(tid < MAX_THREADS);
+    threadSlots[tid].sim = makeCacheSimulator(cacheConfig);
+    PIN_GetLock(&sharedLock, tid + 1);
+    if (tid + 1 > numThreads)
+        numThreads = tid + 1;
+    PIN_ReleaseLock(&sharedLock);
 }
 
 // This knob will set the outfile name
@@ -341,13 +269,232 @@ KNOB<UINT32> KnobLogBlockSize(KNOB_MODE_WRITEONCE, "pintool",
 KNOB<UINT32> KnobAssociativity(KNOB_MODE_WRITEONCE, "pintool",
         "a", "2", "specify the associativity of the cache");
 
+// This knob will set the structure used to track LRU order within a row
+KNOB<string> KnobRecency(KNOB_MODE_WRITEONCE, "pintool",
+        "lru", "age", "specify the recency structure: queue, age (queue from 256 ways), matrix (exact LRU, up to 64 ways) or plru");
+
+// This knob will set the replacement policy, overriding -lru unless it is lru
+KNOB<string> KnobReplacement(KNOB_MODE_WRITEONCE, "pintool",
+        "repl", "lru", "specify the replacement policy: lru (as set by -lru), plru, random, fifo, nru, srrip, brrip or opt");
+
+// This knob will set how many references ahead -repl opt sees
+KNOB<UINT32> KnobOptWindow(KNOB_MODE_WRITEONCE, "pintool",
+        "optw", "262144", "specify the lookahead window of -repl opt in references");
+
+// This knob will set the number of TLB entries, 0 disables the TLB model
+KNOB<UINT32> KnobTlbEntries(KNOB_MODE_WRITEONCE, "pintool",
+        "tlbe", "0", "specify the number of TLB entries (0 for no TLB)");
+
+// This knob will set the TLB associativity
+KNOB<UINT32> KnobTlbAssociativity(KNOB_MODE_WRITEONCE, "pintool",
+        "tlba", "4", "specify the associativity of the TLB");
+
+// This knob will enable the write-policy hierarchy fed by physical addresses
+KNOB<BOOL> KnobHierarchy(KNOB_MODE_WRITEONCE, "pintool",
+        "hier", "0", "simulate an L1 with the -r/-b/-a geometry, an optional L2 and memory traffic");
+
+// These knobs will set the write policies of every hierarchy level
+KNOB<BOOL> KnobWriteBack(KNOB_MODE_WRITEONCE, "pintool",
+        "wb", "1", "specify write-back (1) or write-through (0) hierarchy caches");
+KNOB<BOOL> KnobWriteAllocate(KNOB_MODE_WRITEONCE, "pintool",
+        "wa", "1", "specify whether hierarchy write misses allocate");
+
+// These knobs will set the L2 geometry, -l2a 0 disables the L2
+KNOB<UINT32> KnobL2LogNumRows(KNOB_MODE_WRITEONCE, "pintool",
+        "l2r", "12", "specify the log of number of rows in the L2");
+KNOB<UINT32> KnobL2LogBlockSize(KNOB_MODE_WRITEONCE, "pintool",
+        "l2b", "6", "specify the log of block size of the L2 in bytes");
+KNOB<UINT32> KnobL2Associativity(KNOB_MODE_WRITEONCE, "pintool",
+        "l2a", "0", "specify the associativity of the L2 (0 for no L2)");
+
+// These knobs will set the latencies used for the average memory access time
+KNOB<UINT32> KnobL1Latency(KNOB_MODE_WRITEONCE, "pintool",
+        "lat1", "1", "specify the L1 hit latency in cycles");
+KNOB<UINT32> KnobL2Latency(KNOB_MODE_WRITEONCE, "pintool",
+        "lat2", "10", "specify the L2 hit latency in cycles");
+KNOB<UINT32> KnobMemLatency(KNOB_MODE_WRITEONCE, "pintool",
+        "latm", "100", "specify the memory latency in cycles");
+
+// These knobs will switch between -asids address spaces every -cs
+// references, each running the traced program on its own physical pages
+// except for the -shared percent of pages mapped alike in all of them
+KNOB<UINT64> KnobContextSwitchRefs(KNOB_MODE_WRITEONCE, "pintool",
+        "cs", "0", "specify the references between context switches (0 for none)");
+KNOB<UINT32> KnobNumAsids(KNOB_MODE_WRITEONCE, "pintool",
+        "asids", "2", "specify the number of address spaces to switch between");
+KNOB<BOOL> KnobAsidTagged(KNOB_MODE_WRITEONCE, "pintool",
+        "asidtag", "0", "tag VIVT lines and TLB entries with ASIDs instead of flushing them");
+KNOB<UINT32> KnobSharedPagePercent(KNOB_MODE_WRITEONCE, "pintool",
+        "shared", "0", "specify the percentage of pages shared by every address space");
+
+// This knob will count the VIVT fills that alias a resident physical line
+KNOB<BOOL> KnobSynonyms(KNOB_MODE_WRITEONCE, "pintool",
+        "syn", "0", "count synonyms in the virtual index caches (virtual index physical tag only when its index exceeds the page offset)");
+
+// This knob will set the trace capture file, replayed offline by ./replay
+KNOB<string> KnobTraceFile(KNOB_MODE_WRITEONCE, "pintool",
+        "trace", "", "specify a file to capture the reference trace into");
+
+// This knob will set the stack distance outfile name, which enables the
+// single-pass sweep over every logNumRows and associativity for -b
+KNOB<string> KnobStackDistanceFile(KNOB_MODE_WRITEONCE, "pintool",
+        "sd", "", "specify a file for the all-associativity hit matrix");
+
+// This knob will set the largest logNumRows of the stack distance sweep
+KNOB<UINT32> KnobStackDistanceLogNumRows(KNOB_MODE_WRITEONCE, "pintool",
+        "sdr", "12", "specify the largest log of number of rows in the stack distance sweep");
+
+// This knob will set the largest associativity of the stack distance sweep
+KNOB<UINT32> KnobStackDistanceAssociativity(KNOB_MODE_WRITEONCE, "pintool",
+        "sda", "32", "specify the largest associativity in the stack distance sweep");
+
+// This knob will set the reuse distance outfile name, which enables the
+// reuse distance histogram and miss ratio curve for lines of -b bytes
+KNOB<string> KnobReuseDistanceFile(KNOB_MODE_WRITEONCE, "pintool",
+        "rd", "", "specify a file for the reuse distance histogram and working set");
+
+// This knob will set the number of references per working set interval
+KNOB<UINT64> KnobReuseDistanceInterval(KNOB_MODE_WRITEONCE, "pintool",
+        "rdi", "1000000", "specify the references per working set interval (0 for none)");
+
+// This knob will set the per-instruction miss report outfile name
+KNOB<string> KnobPcFile(KNOB_MODE_WRITEONCE, "pintool",
+        "pc", "", "specify a file for the instructions with the most misses");
+
+// This knob will set the number of instructions in the miss report
+KNOB<UINT32> KnobPcTop(KNOB_MODE_WRITEONCE, "pintool",
+        "pcn", "20", "specify the number of instructions in the miss report");
+
+// This knob will set the per-thread reference buffer size in pages. With
+// 0 the models are called before every memory instruction instead.
+KNOB<UINT32> KnobBufferPages(KNOB_MODE_WRITEONCE, "pintool",
+        "buf", "0", "specify the per-thread reference buffer size in pages (0 for no buffering)");
+
+// This knob will give every thread its own private models, reported per
+// thread and in total
+KNOB<BOOL> KnobPerThread(KNOB_MODE_WRITEONCE, "pintool",
+        "mt", "0", "simulate private caches for every thread");
+
+// These knobs will set the sampling period: -sw references of warmup, -sm
+// measured references and -ss skipped references. -sm 0 disables sampling.
+KNOB<UINT64> KnobSampleWarmup(KNOB_MODE_WRITEONCE, "pintool",
+        "sw", "0", "specify the number of warmup references per sample");
+KNOB<UINT64> KnobSampleMeasure(KNOB_MODE_WRITEONCE, "pintool",
+        "sm", "0", "specify the number of measured references per sample (0 for no sampling)");
+KNOB<UINT64> KnobSampleSkip(KNOB_MODE_WRITEONCE, "pintool",
+        "ss", "0", "specify the number of skipped references between samples");
+
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v)
 {
-    if(INS_IsMemoryRead(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheLoad, IARG_MEMORYREAD_EA, IARG_END);
-    if(INS_IsMemoryWrite(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheStore, IARG_MEMORYWRITE_EA, IARG_END);
+    if (refBuffer != BUFFER_ID_INVALID) {
+        if(INS_IsMemoryRead(ins))
+            INS_InsertFillBuffer(ins, IPOINT_BEFORE, refBuffer,
+                    IARG_MEMORYREAD_EA, offsetof(MemRef, virtualAddr),
+                    IARG_UINT32, 0, offsetof(MemRef, isWrite), IARG_END);
+        if(INS_IsMemoryWrite(ins))
+            INS_InsertFillBuffer(ins, IPOINT_BEFORE, refBuffer,
+                    IARG_MEMORYWRITE_EA, offsetof(MemRef, virtualAddr),
+                    IARG_UINT32, 1, offsetof(MemRef, isWrite), IARG_END);
+        return;
+    }
+
+    bool capture = !KnobTraceFile.Value().empty();
+    bool stackDistance = !KnobStackDistanceFile.Value().empty();
+    bool reuseDistance = !KnobReuseDistanceFile.Value().empty();
+    if (pcReport && (INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins))) {
+        RTN rtn = INS_Rtn(ins);
+        if (RTN_Valid(rtn))
+            pcNames[INS_Address(ins)] = IMG_Name(SEC_Img(RTN_Sec(rtn))) + ":" + RTN_Name(rtn);
+    }
+    if (perThread) {
+        if(INS_IsMemoryRead(ins)) {
+            if (capture)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedTraceLoad, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
+            if (stackDistance)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedStackDistanceLoad, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
+            if (reuseDistance)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedReuseDistanceLoad, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
+            if (pcReport)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)threadLoadPc, IARG_THREAD_ID, IARG_INST_PTR, IARG_MEMORYREAD_EA, IARG_END);
+            else
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)threadLoad, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
+        }
+        if(INS_IsMemoryWrite(ins)) {
+            if (capture)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedTraceStore, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
+            if (stackDistance)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedStackDistanceStore, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
+            if (reuseDistance)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedReuseDistanceStore, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
+            if (pcReport)
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)threadStorePc, IARG_THREAD_ID, IARG_INST_PTR, IARG_MEMORYWRITE_EA, IARG_END);
+            else
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)threadStore, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
+        }
+        return;
+    }
+
+    if(INS_IsMemoryRead(ins)) {
+        if (capture)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedTraceLoad, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
+        if (stackDistance)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)stackDistanceLoad, IARG_MEMORYREAD_EA, IARG_END);
+        if (reuseDistance)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)reuseDistanceLoad, IARG_MEMORYREAD_EA, IARG_END);
+        if (samplePeriod) {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)sampleDetailed, IARG_FAST_ANALYSIS_CALL, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)sampledAccess, IARG_MEMORYREAD_EA, IARG_BOOL, false, IARG_END);
+        } else if (pcReport)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheSim->loadPc, IARG_PTR, cacheSim, IARG_INST_PTR, IARG_MEMORYREAD_EA, IARG_END);
+        else
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheSim->load, IARG_PTR, cacheSim, IARG_MEMORYREAD_EA, IARG_END);
+    }
+    if(INS_IsMemoryWrite(ins)) {
+        if (capture)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)lockedTraceStore, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
+        if (stackDistance)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)stackDistanceStore, IARG_MEMORYWRITE_EA, IARG_END);
+        if (reuseDistance)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)reuseDistanceStore, IARG_MEMORYWRITE_EA, IARG_END);
+        if (samplePeriod) {
+            INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)sampleDetailed, IARG_FAST_ANALYSIS_CALL, IARG_END);
+            INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)sampledAccess, IARG_MEMORYWRITE_EA, IARG_BOOL, true, IARG_END);
+        } else if (pcReport)
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheSim->storePc, IARG_PTR, cacheSim, IARG_INST_PTR, IARG_MEMORYWRITE_EA, IARG_END);
+        else
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)cacheSim->store, IARG_PTR, cacheSim, IARG_MEMORYWRITE_EA, IARG_END);
+    }
+}
+
+// Orders instructions by physically-indexed physically-tagged misses, most first
+int comparePcMisses(const void* a, const void* b)
+{
+    UINT64 ma = ((const PcStats*) a)->misses[0], mb = ((const PcStats*) b)->misses[0];
+    return ma < mb ? 1 : ma > mb ? -1 : 0;
+}
+
+// Writes the instructions with the most misses, one per line:
+// pc,image:routine,accesses, then misses and miss ratio of every model
+void dumpPcResults(FILE* outFile, PcMissTable& table, UINT32 top, UINT32 numModels)
+{
+    UINT32 n = table.size();
+    PcStats* stats = new PcStats[n];
+    table.collect(stats);
+    qsort(stats, n, sizeof(PcStats), comparePcMisses);
+    fprintf(outFile, "pc,name,accesses");
+    for (UINT32 m = 0; m < numModels; m++)
+        fprintf(outFile, ",%s misses,ratio", MODEL_NAMES[m]);
+    fprintf(outFile, "\n");
+    for (UINT32 i = 0; i < n && i < top; i++) {
+        std::map<ADDRINT, string>::iterator name = pcNames.find((ADDRINT) stats[i].pc);
+        fprintf(outFile, "0x%lx,%s,%lu", (unsigned long) stats[i].pc,
+                name == pcNames.end() ? "?" : name->second.c_str(), stats[i].accesses);
+        for (UINT32 m = 0; m < numModels; m++)
+            fprintf(outFile, ",%lu,%f", stats[i].misses[m], (double) stats[i].misses[m] / stats[i].accesses);
+        fprintf(outFile, "\n");
+    }
+    delete[] stats;
 }
 
 // This function is called when the application exits
@@ -355,18 +502,54 @@ VOID Fini(INT32 code, VOID *v)
 {
     FILE* outfile;
     assert(outfile = fopen(KnobOutputFile.Value().c_str(),"w"));
-    fprintf(outfile, "physical index physical tag: ");
-    cachePP->dumpResults(outfile);
-    fprintf(outfile, "virtual index physical tag: ");
-    cacheVP->dumpResults(outfile);
-    fprintf(outfile, "virtual index virtual tag: ");
-    cacheVV->dumpResults(outfile);
+    if (perThread) {
+        // The totals come first in the usual format, then each thread
+        for (UINT32 tid = 0; tid < numThreads; tid++)
+            if (threadSlots[tid].sim)
+                cacheSim->addResults(threadSlots[tid].sim);
+        cacheSim->dumpResults(outfile);
+        for (UINT32 tid = 0; tid < numThreads; tid++) {
+            if (!threadSlots[tid].sim)
+                continue;
+            fprintf(outfile, "thread %u\n", tid);
+            threadSlots[tid].sim->dumpResults(outfile);
+        }
+    } else
+        cacheSim->dumpResults(outfile);
+    if (samplePeriod)
+        sampler.dumpResults(outfile);
     //fprintf(outfile, "milaligned loads and stores: "); 
     //fprintf(outfile, "%lu,%lu\n", numMisalignedLoads, numMisalignedStores);
     //fprintf(outfile, "highest and lowest virtual addr: "); 
     //fprintf(outfile, "%d,%d\n", highestVirtualAddr, lowestVirtualAddr);
     //fprintf(outfile, "highest and lowest physical addr: "); 
     //fprintf(outfile, "%d,%d\n", highestPhysicalAddr, lowestPhysicalAddr);
+    traceWriter.close();
+
+    if (!KnobStackDistanceFile.Value().empty()) {
+        FILE* sdfile;
+        assert(sdfile = fopen(KnobStackDistanceFile.Value().c_str(),"w"));
+        dumpStackDistanceResults(sdfile, stackDistPhys, stackDistVirtPhys, stackDistVirt);
+        fclose(sdfile);
+    }
+
+    if (reuseDist) {
+        FILE* rdfile;
+        assert(rdfile = fopen(KnobReuseDistanceFile.Value().c_str(),"w"));
+        reuseDist->dumpResults(rdfile);
+        fclose(rdfile);
+    }
+
+    if (pcReport) {
+        // Under -mt the per-thread tables are merged into cacheSim's
+        for (UINT32 tid = 0; perThread && tid < numThreads; tid++)
+            if (threadSlots[tid].sim)
+                cacheSim->pcTable.addResults(threadSlots[tid].sim->pcTable);
+        FILE* pcfile;
+        assert(pcfile = fopen(KnobPcFile.Value().c_str(),"w"));
+        dumpPcResults(pcfile, cacheSim->pcTable, KnobPcTop.Value(), cacheConfig.tlbEntries ? 4 : 3);
+        fclose(pcfile);
+    }
 }
 
 // argc, argv are the entire command line, including pin -t <toolname> -- ...
@@ -378,9 +561,80 @@ int main(int argc, char * argv[])
     logPageSize = KnobLogPageSize.Value();
     logPhysicalMemSize = KnobLogPhysicalMemSize.Value();
 
-    cachePP = new LruPhysIndexPhysTagCacheModel(KnobLogNumRows.Value(), KnobLogBlockSize.Value(), KnobAssociativity.Value()); 
-    cacheVP = new LruVirIndexPhysTagCacheModel(KnobLogNumRows.Value(), KnobLogBlockSize.Value(), KnobAssociativity.Value());
-    cacheVV = new LruVirIndexVirTagCacheModel(KnobLogNumRows.Value(), KnobLogBlockSize.Value(), KnobAssociativity.Value());
+    CacheConfig& config = cacheConfig;
+    config.logNumRows = KnobLogNumRows.Value();
+    config.logBlockSize = KnobLogBlockSize.Value();
+    config.associativity = KnobAssociativity.Value();
+    config.recency = parseRecencyPolicy(KnobRecency.Value().c_str());
+    if (KnobReplacement.Value() != "lru")
+        config.recency = parseRecencyPolicy(KnobReplacement.Value().c_str());
+    assert(config.recency != RECENCY_INVALID);
+    config.optWindow = KnobOptWindow.Value();
+    config.tlbEntries = KnobTlbEntries.Value();
+    config.tlbAssociativity = KnobTlbAssociativity.Value();
+    config.hierarchy = KnobHierarchy.Value();
+    config.writeBack = KnobWriteBack.Value();
+    config.writeAllocate = KnobWriteAllocate.Value();
+    config.l2LogNumRows = KnobL2LogNumRows.Value();
+    config.l2LogBlockSize = KnobL2LogBlockSize.Value();
+    config.l2Associativity = KnobL2Associativity.Value();
+    config.l1Latency = KnobL1Latency.Value();
+    config.l2Latency = KnobL2Latency.Value();
+    config.memLatency = KnobMemLatency.Value();
+    config.contextSwitchRefs = KnobContextSwitchRefs.Value();
+    config.numAsids = KnobNumAsids.Value();
+    config.asidTagged = KnobAsidTagged.Value();
+    config.sharedPagePercent = KnobSharedPagePercent.Value();
+    config.trackSynonyms = KnobSynonyms.Value();
+
+    // Under -mt cacheSim only accumulates the per-thread totals
+    cacheSim = makeCacheSimulator(config);
+    perThread = KnobPerThread.Value();
+    PIN_InitLock(&sharedLock);
+
+    // Sampling drives the single shared simulator, reference by reference
+    if (KnobSampleMeasure.Value()) {
+        assert(!perThread && !KnobBufferPages.Value());
+        sampleSkip = KnobSampleSkip.Value();
+        sampleMeasureStart = sampleSkip + KnobSampleWarmup.Value() + 1;
+        samplePeriod = sampleMeasureStart + KnobSampleMeasure.Value() - 1;
+        samplePos = sampleSkip;
+    }
+
+    // Per-instruction attribution needs every reference and its pc, so it
+    // cannot be sampled or buffered
+    pcReport = !KnobPcFile.Value().empty();
+    if (pcReport) {
+        assert(!samplePeriod && !KnobBufferPages.Value());
+        PIN_InitSymbols();
+    }
+
+    // Belady's policy simulates one stream behind its lookahead window
+    if (config.recency == RECENCY_OPT)
+        assert(!perThread && !samplePeriod && !pcReport);
+
+    if (!KnobTraceFile.Value().empty() && !traceWriter.open(KnobTraceFile.Value().c_str())) {
+        fprintf(stderr, "caches: cannot write reference trace %s\n", KnobTraceFile.Value().c_str());
+        return 1;
+    }
+
+    if (!KnobStackDistanceFile.Value().empty()) {
+        stackDistPhys = new StackDistanceModel(KnobStackDistanceLogNumRows.Value(), KnobLogBlockSize.Value(), KnobStackDistanceAssociativity.Value());
+        stackDistVirt = new StackDistanceModel(KnobStackDistanceLogNumRows.Value(), KnobLogBlockSize.Value(), KnobStackDistanceAssociativity.Value());
+        if (stackDistanceNeedsVirtPhys(KnobStackDistanceLogNumRows.Value(), KnobLogBlockSize.Value()))
+            stackDistVirtPhys = new StackDistanceModel(KnobStackDistanceLogNumRows.Value(), KnobLogBlockSize.Value(), KnobStackDistanceAssociativity.Value());
+    }
+
+    if (!KnobReuseDistanceFile.Value().empty())
+        reuseDist = new ReuseDistanceModel(KnobLogBlockSize.Value(), KnobReuseDistanceInterval.Value());
+
+    if (KnobBufferPages.Value()) {
+        refBuffer = PIN_DefineTraceBuffer(sizeof(MemRef), KnobBufferPages.Value(), BufferFull, 0);
+        assert(refBuffer != BUFFER_ID_INVALID);
+    }
+
+    if (perThread)
+        PIN_AddThreadStartFunction(ThreadStart, 0);
 
     // Register Instruction to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
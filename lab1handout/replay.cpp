@@ -0,0 +1,193 @@
+// Standalone replay driver for traces captured with caches.so -trace.
+//
+// Feeds the recorded reference stream through the three lab1 cache models
+// without Pin, so a benchmark only has to be run under Pin once per sweep:
+//
+//   ./replay -r 10 -b 5 -a 2 -o results.out trace.bin
+//
+// The knobs and the output format match the Pin tool, including -l to pick
+// the replacement policy (-k sets the opt lookahead like -optw) and -e/-w
+// for the TLB entries and associativity. -s additionally writes
+// the stack distance hit matrix for every logNumRows up to -R and every
+// associativity up to -A, like the Pin tool's -sd/-sdr/-sda, and -W/-M/-S
+// sample the models like its -sw/-sm/-ss. -d writes the reuse distance
+// histogram and the working set of every -i references, like -rd/-rdi.
+// -H adds the write-policy hierarchy (-hier): -T makes it write-through,
+// -N disables write-allocate, -x/-y/-z set the L2 like -l2r/-l2b/-l2a and
+// -L l1:l2:memory sets the latencies. -c/-n/-g/-u switch address spaces
+// like -cs/-asids/-asidtag/-shared and -Y counts VIVT and VIPT synonyms like -syn.
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include "cache_models.h"
+#include "cache_trace.h"
+
+// Declared by cache_models.h
+UINT32 logPageSize;
+UINT32 logPhysicalMemSize;
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-o outfile] [-m logPhysicalMemSize] [-p logPageSize] "
+            "[-r logNumRows] [-b logBlockSize] [-a associativity] [-l queue|age|matrix|plru|random|fifo|nru|srrip|brrip|opt] [-k optWindow] "
+            "[-e tlbEntries] [-w tlbAssociativity] "
+            "[-s sdfile] [-R maxLogNumRows] [-A maxAssociativity] "
+            "[-W warmup -M measure -S skip] [-d rdfile] [-i interval] "
+            "[-H [-T] [-N] [-x l2LogNumRows] [-y l2LogBlockSize] [-z l2Associativity] [-L l1:l2:memory]] "
+            "[-c contextSwitchRefs [-n asids] [-g] [-u sharedPercent]] [-Y] trace\n", prog);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    const char* outFileName = "results.out";
+    CacheConfig config;
+    const char* sdFileName = NULL;
+    UINT32 maxLogNumRows = 12;
+    UINT32 maxAssociativity = 32;
+    UINT64 sampleWarmup = 0, sampleMeasure = 0, sampleSkip = 0;
+    const char* rdFileName = NULL;
+    UINT64 reuseInterval = 1000000;
+    logPhysicalMemSize = 28;
+    logPageSize = 12;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:m:p:r:b:a:l:k:e:w:s:R:A:W:M:S:d:i:HTNx:y:z:L:c:n:gu:Y")) != -1) {
+        switch (opt) {
+            case 'o': outFileName = optarg; break;
+            case 'm': logPhysicalMemSize = atoi(optarg); break;
+            case 'p': logPageSize = atoi(optarg); break;
+            case 'r': config.logNumRows = atoi(optarg); break;
+            case 'b': config.logBlockSize = atoi(optarg); break;
+            case 'a': config.associativity = atoi(optarg); break;
+            case 'l': config.recency = parseRecencyPolicy(optarg); break;
+            case 'k': config.optWindow = atoi(optarg); break;
+            case 'e': config.tlbEntries = atoi(optarg); break;
+            case 'w': config.tlbAssociativity = atoi(optarg); break;
+            case 's': sdFileName = optarg; break;
+            case 'R': maxLogNumRows = atoi(optarg); break;
+            case 'A': maxAssociativity = atoi(optarg); break;
+            case 'W': sampleWarmup = strtoull(optarg, NULL, 0); break;
+            case 'M': sampleMeasure = strtoull(optarg, NULL, 0); break;
+            case 'S': sampleSkip = strtoull(optarg, NULL, 0); break;
+            case 'd': rdFileName = optarg; break;
+            case 'i': reuseInterval = strtoull(optarg, NULL, 0); break;
+            case 'H': config.hierarchy = true; break;
+            case 'T': config.writeBack = false; break;
+            case 'N': config.writeAllocate = false; break;
+            case 'x': config.l2LogNumRows = atoi(optarg); break;
+            case 'y': config.l2LogBlockSize = atoi(optarg); break;
+            case 'z': config.l2Associativity = atoi(optarg); break;
+            case 'L':
+                if (sscanf(optarg, "%u:%u:%u", &config.l1Latency, &config.l2Latency, &config.memLatency) != 3)
+                    usage(argv[0]);
+                break;
+            case 'c': config.contextSwitchRefs = strtoull(optarg, NULL, 0); break;
+            case 'n': config.numAsids = atoi(optarg); break;
+            case 'g': config.asidTagged = true; break;
+            case 'u': config.sharedPagePercent = atoi(optarg); break;
+            case 'Y': config.trackSynonyms = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || config.recency == RECENCY_INVALID)
+        usage(argv[0]);
+    // Reading the sampled counters would drain the opt lookahead window
+    if (config.recency == RECENCY_OPT && sampleMeasure)
+        usage(argv[0]);
+
+    TraceReader trace;
+    if (!trace.open(argv[optind])) {
+        fprintf(stderr, "%s: cannot read trace %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+
+    CacheSimulator* cacheSim = makeCacheSimulator(config);
+    StackDistanceModel* stackDistPhys = NULL;
+    StackDistanceModel* stackDistVirtPhys = NULL;
+    StackDistanceModel* stackDistVirt = NULL;
+    if (sdFileName) {
+        stackDistPhys = new StackDistanceModel(maxLogNumRows, config.logBlockSize, maxAssociativity);
+        if (stackDistanceNeedsVirtPhys(maxLogNumRows, config.logBlockSize))
+            stackDistVirtPhys = new StackDistanceModel(maxLogNumRows, config.logBlockSize, maxAssociativity);
+        stackDistVirt = new StackDistanceModel(maxLogNumRows, config.logBlockSize, maxAssociativity);
+    }
+
+    ReuseDistanceModel* reuseDist = NULL;
+    if (rdFileName)
+        reuseDist = new ReuseDistanceModel(config.logBlockSize, reuseInterval);
+
+    // Same period layout as the Pin tool: warmup, measured, then skipped
+    SampledHitRates sampler;
+    UINT64 measureStart = sampleSkip + sampleWarmup + 1;
+    UINT64 samplePeriod = sampleMeasure ? measureStart + sampleMeasure - 1 : 0;
+    UINT64 samplePos = sampleSkip;
+
+    UINT32 virtualAddr;
+    bool isWrite;
+    while (trace.next(&virtualAddr, &isWrite)) {
+        bool detailed = true;
+        if (samplePeriod) {
+            detailed = ++samplePos > sampleSkip;
+            if (samplePos == measureStart)
+                sampler.begin(cacheSim);
+        }
+        if (isWrite) {
+            if (detailed)
+                cacheSim->store(cacheSim, virtualAddr);
+            if (stackDistPhys) {
+                UINT32 physicalAddr = getPhysicalAddr(virtualAddr);
+                stackDistPhys->writeReq(physicalAddr);
+                if (stackDistVirtPhys)
+                    stackDistVirtPhys->writeReq(virtualAddr, physicalAddr);
+                stackDistVirt->writeReq(virtualAddr);
+            }
+            if (reuseDist)
+                reuseDist->writeReq(virtualAddr);
+        } else {
+            if (detailed)
+                cacheSim->load(cacheSim, virtualAddr);
+            if (stackDistPhys) {
+                UINT32 physicalAddr = getPhysicalAddr(virtualAddr);
+                stackDistPhys->readReq(physicalAddr);
+                if (stackDistVirtPhys)
+                    stackDistVirtPhys->readReq(virtualAddr, physicalAddr);
+                stackDistVirt->readReq(virtualAddr);
+            }
+            if (reuseDist)
+                reuseDist->readReq(virtualAddr);
+        }
+        if (samplePos == samplePeriod && samplePeriod) {
+            sampler.end(cacheSim);
+            samplePos = 0;
+        }
+    }
+
+    FILE* outfile;
+    assert(outfile = fopen(outFileName, "w"));
+    cacheSim->dumpResults(outfile);
+    if (samplePeriod)
+        sampler.dumpResults(outfile);
+    fclose(outfile);
+    delete cacheSim;
+
+    if (sdFileName) {
+        FILE* sdfile;
+        assert(sdfile = fopen(sdFileName, "w"));
+        dumpStackDistanceResults(sdfile, stackDistPhys, stackDistVirtPhys, stackDistVirt);
+        fclose(sdfile);
+        delete stackDistPhys;
+        delete stackDistVirtPhys;
+        delete stackDistVirt;
+    }
+
+    if (rdFileName) {
+        FILE* rdfile;
+        assert(rdfile = fopen(rdFileName, "w"));
+        reuseDist->dumpResults(rdfile);
+        fclose(rdfile);
+        delete reuseDist;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef BP_TYPES_H
+#define BP_TYPES_H
+
+// The branch predictors are shared between the Pin tools and the
+// standalone replay driver. Pin provides the fixed-width typedefs through
+// pin.H; everywhere else we supply the same names from <stdint.h>.
+#ifdef BPREDICTOR_STANDALONE
+#include <stdint.h>
+typedef uint8_t   UINT8;
+typedef uint32_t  UINT32;
+typedef int32_t   INT32;
+typedef uint64_t  UINT64;
+typedef int64_t   INT64;
+typedef uintptr_t ADDRINT;
+typedef bool      BOOL;
+#define TRUE true
+#define FALSE false
+#else
+#include "pin.H"
+#endif
+
+#endif
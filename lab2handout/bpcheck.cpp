@@ -0,0 +1,268 @@
+// Standalone consistency checks for the lab2 predictors, without Pin:
+//
+// - Every FoldedHistory length and width the "tage" configuration uses
+//   matches a brute-force fold of the global history.
+// - Every predictor is run over a synthetic branch stream on its own,
+//   then all of them again through one PredictorBank on several worker
+//   threads, with extra copies of the stateful ones so a worker steps
+//   more than one instance of the same predictor, and every bank line
+//   must match the single run.
+// - A branch trace of near and far, forward and backward jumps and short
+//   and long runs reads back exactly as it was written.
+//
+//   make check            # or ./bpcheck [-n branches] [-j workers]
+//
+// The exit status is nonzero when any check fails.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "branch_predictors.h"
+#include "branch_trace.h"
+#include "predictor_bank.h"
+
+static const UINT64 DEFAULT_BRANCHES = 2000000;
+static const char BANK_PREDICTORS[] =
+    "bht,gshare,local,tournament,alpha21264,tage,nbpatgshare,tage,alpha21264,tage";
+
+// Deterministic 32 bit LCG, so the stream does not depend on the C library
+class Lcg
+{
+        UINT32 state;
+
+    public:
+        Lcg(UINT32 seed) : state(seed) { }
+
+        UINT32 next() {
+            state = state * 1664525u + 1013904223u;
+            return state;
+        }
+};
+
+// Fills ips and taken with n branches of a loop nest: 64 inner loops of
+// varying trip count, each body holding a biased data-dependent branch and
+// one that repeats the outcome of the branch before it
+static void makeStream(UINT64 n, ADDRINT* ips, BOOL* taken)
+{
+    Lcg lcg(1);
+    UINT64 i = 0;
+    for (UINT32 outer = 0; i < n; outer++) {
+        for (UINT32 l = 0; l < 64 && i < n; l++) {
+            ADDRINT base = 0x400000 + l * 0x40;
+            UINT32 trip = 2 + (l * 7 + outer % 3) % 13;
+            for (UINT32 t = 0; t < trip && i < n; t++) {
+                ips[i] = base;
+                taken[i] = (lcg.next() >> 8) % 4 != 0;
+                i++;
+                if (i < n) {
+                    ips[i] = base + 0x10;
+                    taken[i] = taken[i - 1];
+                    i++;
+                }
+                if (i < n) {
+                    ips[i] = base + 0x20;
+                    taken[i] = t + 1 < trip;
+                    i++;
+                }
+            }
+        }
+    }
+}
+
+// Steps a FoldedHistory<OLEN, CLEN> along a random history of the tage
+// configuration's length and compares it after every branch with the XOR
+// of the latest OLEN outcomes, outcome i at bit i % CLEN
+template<size_t OLEN, size_t CLEN>
+static bool checkFold()
+{
+    const UINT32 branches = 5000;
+    GlobalHistory history(200);
+    FoldedHistory<OLEN, CLEN> folded;
+    Lcg lcg(OLEN * 64 + CLEN);
+    for (UINT32 b = 0; b < branches; b++) {
+        history.shiftIn(lcg.next() >> 31);
+        folded.update(history);
+        UINT64 expected = 0;
+        for (UINT64 i = 0; i < OLEN; i++)
+            expected ^= (UINT64) history.get(i) << (i % CLEN);
+        if (folded.getVal() != expected) {
+            printf("fold of %lu into %lu bits: MISMATCH at branch %u\n", (UINT64) OLEN, (UINT64) CLEN, b);
+            return false;
+        }
+    }
+    printf("fold of %lu into %lu bits: ok\n", (UINT64) OLEN, (UINT64) CLEN);
+    return true;
+}
+
+// Index (9 bits) and tag (9 and 8 bits) registers of the tage components
+static bool checkFolds()
+{
+    bool ok = true;
+    ok = checkFold<6, 9>() && ok;
+    ok = checkFold<6, 8>() && ok;
+    ok = checkFold<20, 9>() && ok;
+    ok = checkFold<20, 8>() && ok;
+    ok = checkFold<64, 9>() && ok;
+    ok = checkFold<64, 8>() && ok;
+    ok = checkFold<200, 9>() && ok;
+    ok = checkFold<200, 8>() && ok;
+    return ok;
+}
+
+// Runs BANK_PREDICTORS alone and through a bank of numWorkers threads
+static bool checkBank(const char* prog, UINT64 numBranches, UINT32 numWorkers)
+{
+    ADDRINT* ips = new ADDRINT[numBranches];
+    BOOL* taken = new BOOL[numBranches];
+    makeStream(numBranches, ips, taken);
+
+    PredictorBank bank(BANK_PREDICTORS);
+    if (!bank.valid() || !bank.start(numWorkers)) {
+        fprintf(stderr, "%s: cannot start the predictor bank\n", prog);
+        return false;
+    }
+    for (UINT64 i = 0; i < numBranches; i++)
+        bank.record(ips[i], taken[i]);
+    bank.finish();
+
+    char* bankLines = NULL;
+    size_t bankSize = 0;
+    FILE* bankOut = open_memstream(&bankLines, &bankSize);
+    bank.dumpResults(bankOut);
+    fclose(bankOut);
+
+    // Each predictor of the list on its own, in the bank's output format
+    std::string singleLines;
+    std::string list(BANK_PREDICTORS);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+
+        BranchPredictor* BP = makeBranchPredictor(name.c_str());
+        PredictorStats stats;
+        for (UINT64 i = 0; i < numBranches; i++) {
+            BOOL prediction = BP->makePrediction(ips[i]);
+            BP->makeUpdate(taken[i], prediction, ips[i]);
+            stats.record(prediction, taken[i]);
+        }
+
+        char* line = NULL;
+        size_t lineSize = 0;
+        FILE* lineOut = open_memstream(&line, &lineSize);
+        fprintf(lineOut, "%s ", name.c_str());
+        stats.print(lineOut);
+        fclose(lineOut);
+        printf("%s", line);
+        singleLines += line;
+        free(line);
+    }
+
+    bool ok = singleLines == bankLines;
+    printf("bank of %u predictors on %u workers: %s\n", bank.size(), numWorkers,
+            ok ? "ok" : "MISMATCH");
+    if (!ok)
+        fprintf(stderr, "bank results:\n%s", bankLines);
+    free(bankLines);
+    delete[] ips;
+    delete[] taken;
+    return ok;
+}
+
+// One run of identical branches in the trace round trip
+struct TraceRun
+{
+    ADDRINT ip;
+    BOOL    taken;
+    UINT64  length;
+};
+
+// Writes runs mixing every kind of record the encoding distinguishes
+// through a BranchTraceWriter and checks that BranchTraceReader returns
+// the same branches
+static bool checkTrace()
+{
+    const UINT32 numRuns = 300000;
+    const ADDRINT topAddr = (1ull << 47) - 1;      // highest user space address
+    Lcg lcg(7);
+    std::vector<TraceRun> runs(numRuns);
+    ADDRINT ip = 0x400000;
+    UINT64 numBranches = 0;
+    for (UINT32 r = 0; r < numRuns; r++) {
+        UINT32 kind = lcg.next() >> 29;
+        if (kind < 4)           // near jump either way
+            ip += (ADDRINT) ((INT64) (lcg.next() >> 20) - 2048);
+        else if (kind == 4)     // anywhere in user space
+            ip = (((ADDRINT) lcg.next() << 32) | lcg.next()) & topAddr;
+        else if (kind == 5)     // the ends of user space
+            ip = lcg.next() & (1u << 31) ? topAddr : 0;
+        // otherwise the same branch again, maybe the other way
+        runs[r].ip = ip;
+        runs[r].taken = lcg.next() >> 31;
+        UINT32 len = lcg.next();
+        runs[r].length = (len >> 20) == 0 ? 1 + (len & ((1u << 22) - 1)) : 1 + (len >> 30);
+        numBranches += runs[r].length;
+    }
+
+    char path[] = "/tmp/bpcheckXXXXXX";
+    int fd = mkstemp(path);
+    BranchTraceWriter writer;
+    if (fd < 0 || !writer.open(path)) {
+        printf("trace round trip: cannot write %s\n", path);
+        return false;
+    }
+    close(fd);
+    for (UINT32 r = 0; r < numRuns; r++)
+        for (UINT64 i = 0; i < runs[r].length; i++)
+            writer.record(runs[r].ip, runs[r].taken);
+    writer.close();
+
+    BranchTraceReader reader;
+    bool ok = reader.open(path);
+    ADDRINT readIp;
+    BOOL readTaken;
+    UINT64 n = 0;
+    for (UINT32 r = 0; ok && r < numRuns; r++)
+        for (UINT64 i = 0; ok && i < runs[r].length; i++, n++)
+            ok = reader.next(&readIp, &readTaken) && readIp == runs[r].ip && readTaken == runs[r].taken;
+    ok = ok && !reader.next(&readIp, &readTaken);
+    unlink(path);
+
+    if (ok)
+        printf("trace round trip of %lu branches: ok\n", numBranches);
+    else
+        printf("trace round trip of %lu branches: MISMATCH at branch %lu\n", numBranches, n);
+    return ok;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-n branches] [-j workers]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    UINT64 numBranches = DEFAULT_BRANCHES;
+    UINT32 numWorkers = 4;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:")) != -1) {
+        switch (opt) {
+            case 'n': numBranches = strtoull(optarg, NULL, 0); break;
+            case 'j': numWorkers = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (numWorkers == 0)
+        usage(argv[0]);
+
+    bool ok = checkFolds();
+    ok = checkTrace() && ok;
+    ok = checkBank(argv[0], numBranches, numWorkers) && ok;
+    return ok ? 0 : 1;
+}
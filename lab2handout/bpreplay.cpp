@@ -0,0 +1,99 @@
+// Standalone replay driver for branch traces captured with bpredictor.so -trace.
+//
+// Feeds the recorded conditional branches through one of the lab2
+// predictors without Pin, so a benchmark only has to be run under Pin once
+// while trying predictors:
+//
+//   ./bpreplay -p tournament -o result.out trace.bin
+//
+// -p takes the same names as the Pin tool's -bp and the output matches its
+// result file. A comma-separated list of names replays the trace through
+// all of them in one pass, spread over -j worker threads, and writes one
+// line per predictor, its name first. The replay rate is reported on
+// stderr.
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "branch_predictors.h"
+#include "branch_trace.h"
+#include "predictor_bank.h"
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-o outfile] [-p %s[,...]] [-j workers] trace\n", prog, BRANCH_PREDICTOR_NAMES);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    const char* outFileName = "result.out";
+    const char* predictorNames = "alpha21264";
+    UINT32 numWorkers = 4;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:p:j:")) != -1) {
+        switch (opt) {
+            case 'o': outFileName = optarg; break;
+            case 'p': predictorNames = optarg; break;
+            case 'j': numWorkers = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc)
+        usage(argv[0]);
+
+    PredictorBank bank(predictorNames);
+    if (!bank.valid() || numWorkers == 0)
+        usage(argv[0]);
+
+    BranchTraceReader reader;
+    if (!reader.open(argv[optind])) {
+        fprintf(stderr, "%s: cannot read branch trace %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+
+    // A single predictor runs on this thread, without the bank's rings
+    BranchPredictor* BP = bank.size() == 1 ? bank.getPredictor(0) : NULL;
+    PredictorStats stats;
+    if (!BP && !bank.start(numWorkers)) {
+        fprintf(stderr, "%s: cannot start the worker threads\n", argv[0]);
+        return 1;
+    }
+
+    UINT64 numBranches = 0;
+    double start = now();
+    ADDRINT ip;
+    BOOL direction;
+    while (reader.next(&ip, &direction)) {
+        numBranches++;
+        if (BP) {
+            BOOL prediction = BP->makePrediction(ip);
+            BP->makeUpdate(direction, prediction, ip);
+            stats.record(prediction, direction);
+        } else
+            bank.record(ip, direction);
+    }
+    if (!BP)
+        bank.finish();
+    double elapsed = now() - start;
+    fprintf(stderr, "%lu branches in %.2f s, %.1f Mbranches/s\n", numBranches, elapsed,
+            numBranches / elapsed / 1e6);
+
+    FILE* outfile;
+    assert(outfile = fopen(outFileName, "w"));
+    if (BP)
+        stats.print(outfile);
+    else
+        bank.dumpResults(outfile);
+    fclose(outfile);
+    return 0;
+}
@@ -0,0 +1,1010 @@
+#ifndef BRANCH_PREDICTORS_H
+#define BRANCH_PREDICTORS_H
+
+// The lab2 branch predictors, kept apart from the bpredictor Pin tool so
+// other tools can drive them
+#include <stdio.h>
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_types.h"
+
+//#define DEBUG(format, ...) fprintf(stderr, "%d " format "\n", __LINE__, ##__VA_ARGS__)
+#define DEBUG(format, ...) 
+
+#define truncate(val, bits) ((val)&((1<<(bits))-1))
+const UINT64 MAXIMUM_STORAGE_SIZE = 33792;
+
+// N < 64
+template <size_t N, UINT64 init = (1<<N)/2-1>
+class SaturatingCounter
+{
+    UINT64 val;
+    public:
+        SaturatingCounter() {
+            reset();
+        }
+
+        void increment() {
+            if (val < (1<<N)-1)
+                val++;
+        }
+
+        void decrement() {
+            if (val > 0)
+                val--;
+        }
+
+        void reset() {
+            val = init;
+        }
+
+        UINT64 getVal() {
+            return val;
+        }
+
+        BOOL isTaken() {
+            if (val > (1<<N)/2-1)
+                return true;
+            return false;
+        }
+
+        // N bit register
+        static UINT64 getSize() {
+            return N;
+        }
+};
+
+template <size_t L, size_t N, size_t H, UINT64 init = (1<<N)/2-1>
+class SaturatingCounterWithSharedHystersis
+{
+    UINT64 val[1<<L];
+    BOOL hyst[(1<<L)/H];
+    public:
+        SaturatingCounterWithSharedHystersis() {
+            for (UINT64 i = 0; i < (1<<L); i++) {
+                reset(i);
+            }
+        }
+
+        void increment(UINT64 i) {
+            if (hyst[i/H] == 0)
+                hyst[i/H] = 1;
+            else if (val < (1<<(N-1))-1) {
+                val++;
+                hyst[i/H] = 0;
+            }
+        }
+
+        void decrement(UINT64 i) {
+            if (hyst[i/H] == 1)
+                hyst[i/H] = 0;
+            else if (val > 0) {
+                val--;
+                hyst[i/H] = 1;
+            }
+        }
+
+        void reset(UINT64 i) {
+            val[i] = init >> 1;
+            hyst[i/H] = init & 1;
+        }
+
+        BOOL isTaken() {
+            if (val > (1<<(N-1))/2-1)
+                return true;
+            return false;
+        }
+
+        // N bit register
+        static UINT64 getSize() {
+            return L*N;
+        }
+};
+
+// N < 64
+template<size_t N>
+class ShiftRegister
+{
+    UINT64 val;
+    public:
+        ShiftRegister() {
+            val = 0;
+        }
+
+        bool shiftIn(bool b) {
+            bool ret = !!(val&(1ull<<(N-1)));
+            val <<= 1;
+            val |= b;
+            val &= (1ull<<N)-1;
+            return ret;
+        }
+
+        UINT64 getVal() {
+            return val;
+        }
+
+        // N bit register
+        static UINT64 getSize() {
+            return N;
+        }
+};
+
+// S fields of N bits packed into 64 bit words, 64/N fields to a word, so
+// a table takes about as much host memory as the storage it models.
+// Fields start out zero.
+template <size_t S, size_t N>
+class PackedArray
+{
+    static const UINT64 PER_WORD = 64/N;
+    static const UINT64 MASK = N == 64 ? ~0ull : (1ull<<N)-1;
+    UINT64 words[(S+PER_WORD-1)/PER_WORD];
+    public:
+        PackedArray() {
+            fill(0);
+        }
+
+        UINT64 get(UINT64 i) {
+            return (words[i/PER_WORD] >> (i%PER_WORD*N)) & MASK;
+        }
+
+        void set(UINT64 i, UINT64 v) {
+            UINT64& w = words[i/PER_WORD];
+            UINT64 shift = i%PER_WORD*N;
+            w = (w & ~(MASK << shift)) | ((v & MASK) << shift);
+        }
+
+        void fill(UINT64 v) {
+            UINT64 pattern = 0;
+            for (UINT64 i = 0; i < PER_WORD; i++)
+                pattern |= (v & MASK) << (i*N);
+            for (UINT64 i = 0; i < (S+PER_WORD-1)/PER_WORD; i++)
+                words[i] = pattern;
+        }
+
+        // S N bit fields
+        static UINT64 getSize() {
+            return S*N;
+        }
+};
+
+// 1<<L saturating counters of N bits, N < 64, packed like PackedArray;
+// counter i behaves like a SaturatingCounter<N, init>. Increment and
+// decrement saturate without branching.
+template <size_t L, size_t N, UINT64 init = (1<<N)/2-1>
+class SaturatingCounterArray
+{
+    PackedArray<1<<L, N> val;
+    public:
+        SaturatingCounterArray() {
+            val.fill(init);
+        }
+
+        void increment(UINT64 i) {
+            UINT64 v = val.get(i);
+            val.set(i, v + (v < (1ull<<N)-1));
+        }
+
+        void decrement(UINT64 i) {
+            UINT64 v = val.get(i);
+            val.set(i, v - (v > 0));
+        }
+
+        void reset(UINT64 i) {
+            val.set(i, init);
+        }
+
+        void resetAll() {
+            val.fill(init);
+        }
+
+        UINT64 getVal(UINT64 i) {
+            return val.get(i);
+        }
+
+        BOOL isTaken(UINT64 i) {
+            return val.get(i) >> (N-1);
+        }
+
+        // 1<<L N bit registers
+        static UINT64 getSize() {
+            return (1<<L)*N;
+        }
+};
+
+// 1<<L shift registers of N bits, N < 64, packed like PackedArray;
+// register i behaves like a ShiftRegister<N>
+template <size_t L, size_t N>
+class ShiftRegisterArray
+{
+    PackedArray<1<<L, N> val;
+    public:
+        void shiftIn(UINT64 i, bool b) {
+            val.set(i, (val.get(i) << 1) | b);
+        }
+
+        UINT64 getVal(UINT64 i) {
+            return val.get(i);
+        }
+
+        // 1<<L N bit registers
+        static UINT64 getSize() {
+            return (1<<L)*N;
+        }
+};
+
+inline UINT64 f_xor(UINT64 a, UINT64 b) {
+    return a ^ b;
+}
+
+template<size_t s_a, size_t s_b>
+inline UINT64 f_concat(UINT64 a, UINT64 b) {
+    return ((a&((1<<s_a)-1))<<s_a)|(b&((1<<s_b)-1));
+}
+
+inline UINT64 f_a(UINT64 a, UINT64 b) {
+    return a;
+}
+
+inline UINT64 f_b(UINT64 a, UINT64 b) {
+    return b;
+}
+
+template<size_t L, UINT64 s_a, UINT64 s_b>
+inline UINT64 f_folded_xor(UINT64 a, UINT64 b) {
+    UINT64 v = 0;
+    for (UINT64 i = 0; i < 64/L && (i+1)*L <= s_a; i++) {
+        v ^= truncate(a, L);
+        a >>= L;
+    }
+    for (UINT64 i = 0; i < 64/L && (i+1)*L <= s_b; i++) {
+        v ^= truncate(b, L);
+        b >>= L;
+    }
+    return v;
+}
+
+class BranchPredictor
+{
+    public:
+        BranchPredictor() { }
+
+        virtual BOOL makePrediction(ADDRINT address) { return FALSE; };
+
+        virtual void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {};
+
+        static UINT64 getSize() {
+            return 0;
+        }
+
+};
+
+template<size_t L>
+class BHTPredictor: public BranchPredictor
+{
+    SaturatingCounterArray<L, 2> counter;
+    public:
+        BHTPredictor() { assert (getSize() <= MAXIMUM_STORAGE_SIZE); }
+
+        BOOL makePrediction(ADDRINT address) {
+            return counter.isTaken(truncate(address, L));
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(address, L);
+            if (takenActually)
+                counter.increment(idx);
+            else
+                counter.decrement(idx);
+        }
+
+        static UINT64 getSize() {
+            return SaturatingCounterArray<L, 2>::getSize();
+        }
+};
+
+template<size_t L, size_t H>
+class BHTPredictorWithSharedHysteresis: public BranchPredictor
+{
+    PackedArray<1<<L, 1> counter;
+    PackedArray<(1<<L)/H, 1> hystersis;
+    public:
+        BHTPredictorWithSharedHysteresis() { assert (getSize() <= MAXIMUM_STORAGE_SIZE); }
+
+        BOOL makePrediction(ADDRINT address) {
+            return counter.get(truncate(address, L));
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(address, L);
+            if (takenActually) {
+                if (!hystersis.get(idx/H))
+                    hystersis.set(idx/H, true);
+                else if (!counter.get(idx)) {
+                    counter.set(idx, true); hystersis.set(idx/H, false);
+                }
+            } else {
+                if (hystersis.get(idx/H))
+                    hystersis.set(idx/H, false);
+                else if (counter.get(idx)) {
+                    counter.set(idx, false); hystersis.set(idx/H, true);
+                }
+            }
+        }
+
+        static UINT64 getSize() {
+            return (1<<L)+((1<<L)/H);
+        }
+};
+
+template<size_t L, size_t H, UINT64 (*hash)(UINT64 address, UINT64 history), UINT64 bits = 2>
+class GlobalHistoryPredictor: public BranchPredictor
+{
+    // http://www.eng.utah.edu/~cs6810/pres/10-6810-08.pdf
+    SaturatingCounterArray<L, bits> counter;
+    ShiftRegister<H> globalHistory;
+    public:
+        GlobalHistoryPredictor() { assert (getSize() <= MAXIMUM_STORAGE_SIZE); }
+        BOOL makePrediction(ADDRINT address) {
+            return counter.isTaken(truncate(hash(address, globalHistory.getVal()), L));
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT32 idx = truncate(hash(address, globalHistory.getVal()), L);
+            if (takenActually)
+                counter.increment(idx);
+            else
+                counter.decrement(idx);
+            globalHistory.shiftIn(takenActually);
+        }
+
+        UINT64 getHistory() {
+            return globalHistory.getVal();
+        }
+
+        static UINT64 getSize() {
+            return SaturatingCounterArray<L, bits>::getSize() + ShiftRegister<H>::getSize();
+        }
+};
+
+template<size_t L, size_t H, size_t HL, UINT64 (*hash)(UINT64 address, UINT64 history), UINT64 bits = 2>
+class LocalHistoryPredictor: public BranchPredictor
+{
+    SaturatingCounterArray<L, bits> counter;
+    ShiftRegisterArray<HL, H> hists;
+
+    public:
+        LocalHistoryPredictor() { assert (getSize() <= MAXIMUM_STORAGE_SIZE); }
+
+        BOOL makePrediction(ADDRINT address) {
+            UINT64 hists_idx = truncate(address, HL);
+            return counter.isTaken(truncate(hash(address, hists.getVal(hists_idx)), L));
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 hists_idx = truncate(address, HL);
+            UINT64 idx = truncate(hash(address, hists.getVal(hists_idx)), L);
+            if (takenActually)
+                counter.increment(idx);
+            else
+                counter.decrement(idx);
+            hists.shiftIn(hists_idx, takenActually);
+        }
+
+        static UINT64 getSize() {
+            return SaturatingCounterArray<L, bits>::getSize() + ShiftRegisterArray<HL, H>::getSize();
+        }
+};
+
+template<size_t L, UINT64 bits = 2>
+class TournamentPredictor: public BranchPredictor {
+    SaturatingCounterArray<L, bits> counter;
+    BranchPredictor* BPs[2];
+
+    public:
+        TournamentPredictor(BranchPredictor* BP0, BranchPredictor* BP1) {
+            BPs[0] = BP0;
+            BPs[1] = BP1;
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL makePrediction(ADDRINT address) {
+            if (counter.isTaken(truncate(address, L)))
+                return BPs[1]->makePrediction(address);
+            else
+                return BPs[0]->makePrediction(address);
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(address, L);
+            BOOL pred_0 = BPs[0]->makePrediction(address);
+            BOOL pred_1 = BPs[1]->makePrediction(address);
+            if (takenActually != pred_0 && takenActually == pred_1)
+                counter.increment(idx);
+            else if (takenActually == pred_0 && takenActually != pred_1)
+                counter.decrement(idx);
+            BPs[0]->makeUpdate(takenActually, takenPredicted, address);
+            BPs[1]->makeUpdate(takenActually, takenPredicted, address);
+        }
+
+        UINT64 getSize() {
+            return BPs[0]->getSize() + BPs[1]->getSize() + SaturatingCounterArray<L, bits>::getSize();
+        }
+};
+
+template<size_t L>
+class Alpha21264Predictor: public BranchPredictor {
+    SaturatingCounterArray<L, 2> counter;
+    GlobalHistoryPredictor<L, L, &f_xor> GP;
+    LocalHistoryPredictor<10, 10, 10, &f_b, 3> LP;
+
+    public:
+        Alpha21264Predictor() {
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL makePrediction(ADDRINT address) {
+            if (counter.isTaken(truncate(GP.getHistory(), L)))
+                return GP.makePrediction(address);
+            else
+                return LP.makePrediction(address);
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(GP.getHistory(), L);
+            BOOL pred_0 = GP.makePrediction(address);
+            BOOL pred_1 = LP.makePrediction(address);
+            if (takenActually != pred_0 && takenActually == pred_1)
+                counter.decrement(idx);
+            else if (takenActually == pred_0 && takenActually != pred_1)
+                counter.increment(idx);
+            GP.makeUpdate(takenActually, takenPredicted, address);
+            LP.makeUpdate(takenActually, takenPredicted, address);
+        }
+
+        UINT64 getSize() {
+            return GP.getSize() + LP.getSize() + SaturatingCounterArray<L, 2>::getSize();
+        }
+};
+
+// Global branch history of any length, kept in a circular bit buffer.
+// get(0) is the latest outcome; getVal() has the latest 64 (or length, if
+// shorter) outcomes packed like a ShiftRegister, for hashes that take the
+// history as one word.
+class GlobalHistory
+{
+    UINT64* words;
+    UINT64 mask;        // of bit positions in the buffer
+    UINT64 head;        // position of the latest outcome
+    UINT64 recent;
+    UINT64 length;
+    public:
+        GlobalHistory(UINT64 length) : head(0), recent(0), length(length) {
+            // One spare bit so get(length) still holds the outcome that
+            // just left the history
+            UINT64 bits = 64;
+            while (bits < length + 1)
+                bits <<= 1;
+            mask = bits - 1;
+            words = new UINT64[bits/64];
+            memset(words, 0, bits/8);
+        }
+
+        ~GlobalHistory() {
+            delete[] words;
+        }
+
+        void shiftIn(bool b) {
+            head = (head + 1) & mask;
+            words[head/64] = (words[head/64] & ~(1ull << (head%64))) | ((UINT64) b << (head%64));
+            recent = (recent << 1) | b;
+            if (length < 64)
+                recent &= (1ull<<length)-1;
+        }
+
+        // Outcome of the branch i branches ago, for i <= getLength()
+        bool get(UINT64 i) const {
+            UINT64 pos = (head - i) & mask;
+            return (words[pos/64] >> (pos%64)) & 1;
+        }
+
+        UINT64 getVal() const {
+            return recent;
+        }
+
+        UINT64 getLength() const {
+            return length;
+        }
+};
+
+// The latest OLEN outcomes of a GlobalHistory folded by XOR into CLEN
+// bits, outcome i landing on bit i%CLEN. As in Seznec's TAGE it is kept
+// up to date in O(1) per branch: the new outcome is shifted in, the one
+// leaving the window is cancelled at the bit it had reached, and the bit
+// shifted out at the top wraps around to bit 0.
+template<size_t OLEN, size_t CLEN>
+class FoldedHistory
+{
+    UINT64 comp;
+    public:
+        FoldedHistory() : comp(0) { }
+
+        // Call after h has shifted in the latest outcome
+        void update(const GlobalHistory& h) {
+            comp = (comp << 1) | h.get(0);
+            comp ^= (UINT64) h.get(OLEN) << (OLEN % CLEN);
+            comp ^= comp >> CLEN;
+            comp &= (1ull<<CLEN)-1;
+        }
+
+        UINT64 getVal() {
+            return comp;
+        }
+
+        // CLEN bit register
+        static UINT64 getSize() {
+            return CLEN;
+        }
+};
+
+class TagePredictorComponentBase {
+public:
+    TagePredictorComponentBase() { }
+
+    virtual BOOL predict(ADDRINT address, UINT64 hist, BOOL *taken) { assert (false); return false; };
+
+    virtual void update(BOOL takenActually, BOOL takenPredicted, ADDRINT address, UINT64 hist, BOOL altpred) { };
+
+    virtual BOOL allocate(ADDRINT address, UINT64 hist, BOOL takenActually) { assert (false); return false; };
+
+    virtual void decrement_u(ADDRINT address, UINT64 hist) { };
+
+    virtual void reset_u() { };
+
+    // Called once the global history has shifted in each branch outcome
+    virtual void updateHistory(const GlobalHistory& h) { };
+
+    // Longest history the component reads from the GlobalHistory
+    virtual UINT64 getHistoryLength() { return 0; };
+
+    virtual UINT64 getSize() { assert (false); return 0; };
+};
+
+template<size_t LL, size_t T, UINT64 (*hash)(UINT64 address, UINT64 history), UINT64 (*hash_tag)(UINT64 address, UINT64 history)>
+class TagePredictorComponent : public TagePredictorComponentBase {
+    SaturatingCounterArray<LL, 3> ctr;
+    SaturatingCounterArray<LL, 2, 0> u;
+    PackedArray<1<<LL, T> tag;
+
+    public:
+        TagePredictorComponent() {
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL predict(ADDRINT address, UINT64 hist, BOOL* taken) {
+            DEBUG("DEBUG");
+            UINT64 idx = truncate(hash(address, hist), LL);
+            *taken = ctr.isTaken(idx);
+            DEBUG("DEBUG");
+            return (tag.get(idx) == truncate(hash_tag(address, hist), T));
+        }
+
+        void update(BOOL takenActually, BOOL takenPredicted, ADDRINT address, UINT64 hist, BOOL altpred) {
+            DEBUG("DEBUG");
+            int idx = truncate(hash(address, hist), LL);
+            if (altpred != takenPredicted) {
+                if (takenActually == takenPredicted)
+                    u.increment(idx);
+                else
+                    u.decrement(idx);
+            }
+
+            DEBUG("DEBUG");
+            if (takenActually)
+                ctr.increment(idx);
+            else
+                ctr.decrement(idx);
+            DEBUG("DEBUG");
+        }
+
+        BOOL allocate(ADDRINT address, UINT64 hist, BOOL takenActually) {
+            DEBUG("DEBUG");
+            int idx = truncate(hash(address, hist), LL);
+            if (u.getVal(idx) == 0) {
+                ctr.reset(idx);
+                if (takenActually)
+                    ctr.increment(idx);
+                tag.set(idx, hash_tag(address, hist));
+                return true;
+            }
+            DEBUG("DEBUG");
+            return false;
+        }
+
+        void decrement_u(ADDRINT address, UINT64 hist) {
+            u.decrement(truncate(hash(address, hist), LL));
+        }
+
+        void reset_u() {
+            u.resetAll();
+        }
+
+        UINT64 getSize() {
+            return SaturatingCounterArray<LL, 3>::getSize() + SaturatingCounterArray<LL, 2, 0>::getSize() + PackedArray<1<<LL, T>::getSize();
+        }
+};
+
+// Tagged TAGE component over the latest HLEN outcomes, which may be many
+// more than 64. Index and tag hash the address with FoldedHistory
+// registers of the history instead of re-folding it on every lookup.
+template<size_t LL, size_t T, size_t HLEN>
+class FoldedTagePredictorComponent : public TagePredictorComponentBase {
+    SaturatingCounterArray<LL, 3> ctr;
+    SaturatingCounterArray<LL, 2, 0> u;
+    PackedArray<1<<LL, T> tag;
+    FoldedHistory<HLEN, LL> indexHist;
+    FoldedHistory<HLEN, T> tagHist0;
+    FoldedHistory<HLEN, T-1> tagHist1;
+
+    UINT64 index(ADDRINT address) {
+        return truncate(address ^ (address >> LL) ^ indexHist.getVal(), LL);
+    }
+
+    UINT64 tagOf(ADDRINT address) {
+        return truncate(address ^ tagHist0.getVal() ^ (tagHist1.getVal() << 1), T);
+    }
+
+    public:
+        FoldedTagePredictorComponent() {
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL predict(ADDRINT address, UINT64 hist, BOOL* taken) {
+            UINT64 idx = index(address);
+            *taken = ctr.isTaken(idx);
+            return tag.get(idx) == tagOf(address);
+        }
+
+        void update(BOOL takenActually, BOOL takenPredicted, ADDRINT address, UINT64 hist, BOOL altpred) {
+            UINT64 idx = index(address);
+            if (altpred != takenPredicted) {
+                if (takenActually == takenPredicted)
+                    u.increment(idx);
+                else
+                    u.decrement(idx);
+            }
+            if (takenActually)
+                ctr.increment(idx);
+            else
+                ctr.decrement(idx);
+        }
+
+        BOOL allocate(ADDRINT address, UINT64 hist, BOOL takenActually) {
+            UINT64 idx = index(address);
+            if (u.getVal(idx) == 0) {
+                ctr.reset(idx);
+                if (takenActually)
+                    ctr.increment(idx);
+                tag.set(idx, tagOf(address));
+                return true;
+            }
+            return false;
+        }
+
+        void decrement_u(ADDRINT address, UINT64 hist) {
+            u.decrement(index(address));
+        }
+
+        void reset_u() {
+            u.resetAll();
+        }
+
+        void updateHistory(const GlobalHistory& h) {
+            indexHist.update(h);
+            tagHist0.update(h);
+            tagHist1.update(h);
+        }
+
+        UINT64 getHistoryLength() {
+            return HLEN;
+        }
+
+        UINT64 getSize() {
+            return SaturatingCounterArray<LL, 3>::getSize() + SaturatingCounterArray<LL, 2, 0>::getSize() + PackedArray<1<<LL, T>::getSize() +
+                FoldedHistory<HLEN, LL>::getSize() + FoldedHistory<HLEN, T>::getSize() + FoldedHistory<HLEN, T-1>::getSize();
+        }
+};
+
+template<size_t LL, size_t H>
+class TageBasePredictor : public TagePredictorComponentBase {
+    BHTPredictorWithSharedHysteresis<LL, H> T0;
+
+    public:
+        TageBasePredictor() {
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL predict(ADDRINT address, UINT64 hist, BOOL* taken) {
+            DEBUG("DEBUG");
+            *taken = T0.makePrediction(address);
+            DEBUG("DEBUG");
+            return true;
+        }
+
+        void update(BOOL takenActually, BOOL takenPredicted, ADDRINT address, UINT64 hist, BOOL altpred) {
+            DEBUG("DEBUG");
+            T0.makeUpdate(takenActually, takenPredicted, address);
+            DEBUG("DEBUG");
+        }
+
+        BOOL allocate(ADDRINT address, UINT64 hist, BOOL takenActually) { assert (false); return false; }
+
+        void decrement_u(ADDRINT address, UINT64 hist) { 
+            assert (false);
+        }
+
+        void reset_u() { }
+
+        UINT64 getSize() {
+            return BHTPredictor<LL>::getSize();
+        }
+};
+
+template<size_t N, size_t G>
+class TagePredictor : public BranchPredictor {
+    TagePredictorComponentBase* Ts[N];
+    GlobalHistory globalHistory;
+    UINT64 noOfBranches;
+    UINT32 state;       // LCG picking the allocation start, seeded alike in every instance
+
+    public:
+        TagePredictor(TagePredictorComponentBase* T0, ...) : globalHistory(G) {
+            va_list stages;
+            va_start(stages, T0);
+            Ts[0] = T0;
+            for (UINT64 i = 1; i < N; i++) {
+                TagePredictorComponentBase* j = va_arg(stages, TagePredictorComponentBase*);
+                Ts[i] = j;
+            }
+            va_end(stages);
+            noOfBranches = 0;
+            state = 1;
+            for (UINT64 i = 0; i < N; i++)
+                assert (Ts[i]->getHistoryLength() <= G);
+            assert (getSize() <= MAXIMUM_STORAGE_SIZE);
+        }
+
+        void getPredictionsAndProviders(ADDRINT address, UINT64 *pred_p, bool *pred, bool* altpred) {
+            DEBUG("DEBUG");
+            UINT64 i;
+            for (i = N - 1; i >= 0; i--) {
+                if (Ts[i]->predict(address, globalHistory.getVal(), pred))
+                    break;
+            }
+            DEBUG("DEBUG");
+
+            if (pred_p)
+                *pred_p = i;
+            if (!altpred)
+                return;
+
+            DEBUG("DEBUG");
+            for(i--; i >= 0 && i < N; i--) {
+                DEBUG("DEBUG %lu", i);
+                if (Ts[i]->predict(address, globalHistory.getVal(), altpred))
+                    return;
+            }
+            DEBUG("DEBUG");
+            *altpred = *pred;
+        }
+
+        BOOL makePrediction(ADDRINT address) {
+            DEBUG("DEBUG");
+            BOOL pred;
+            getPredictionsAndProviders(address, NULL, &pred, NULL);
+            DEBUG("DEBUG");
+            return pred;
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            noOfBranches++;
+            if (noOfBranches >= 256e3) {
+                noOfBranches = 0;
+                for (UINT64 i = 0; i < N; i++) {
+                    Ts[i]->reset_u();
+                }
+            }
+
+            DEBUG("DEBUG");
+            UINT64 pred_p;
+            BOOL pred, altpred;
+            getPredictionsAndProviders(address, &pred_p, &pred, &altpred);
+            assert (pred == takenPredicted);
+            DEBUG("DEBUG");
+            Ts[pred_p]->update(takenActually, takenPredicted, address, globalHistory.getVal(), altpred);
+            DEBUG("DEBUG");
+            if (takenActually != takenPredicted) {
+                UINT64 k_offset = 0;
+                state = state * 1664525u + 1013904223u;
+                UINT64 tmp = (state >> 8) % (1 << (N-pred_p-1));
+                while (tmp >>= 1) k_offset++;
+                BOOL allocated = false;
+                for (UINT64 k = 0; k < N - (pred_p + 1) && !allocated; k++) {
+                    allocated = Ts[pred_p + 1 + ((k+k_offset)%(N - (pred_p + 1)))]->allocate(address, globalHistory.getVal(), takenActually);
+                    DEBUG("DEBUG");
+                }
+
+                // Allocation failed, decrement useful counters
+                for (UINT64 j = pred_p + 1; j < N && !allocated; j++) {
+                    Ts[j]->decrement_u(address, globalHistory.getVal());
+                }
+            }
+            DEBUG("DEBUG");
+
+            globalHistory.shiftIn(takenActually);
+            for (UINT64 i = 0; i < N; i++) {
+                Ts[i]->updateHistory(globalHistory);
+            }
+        }
+
+        UINT64 getSize() {
+            UINT64 size = G;
+            for (UINT64 i = 0; i < N; i++) {
+                size += Ts[i]->getSize();
+            }
+            return size;
+        }
+};
+
+template<size_t N, size_t L>
+class NaiveBPAT : public BranchPredictor {
+    ShiftRegisterArray<L, 2*N> history;
+    SaturatingCounterArray<L, 2> counter;
+    BranchPredictor* altPredictor;
+
+    public:
+        NaiveBPAT(BranchPredictor* alt) {
+            altPredictor = alt;
+            assert(getSize() < MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL predict(ADDRINT address, BOOL* pred) {
+            UINT64 idx = truncate(address, L);
+            UINT64 haystack = history.getVal(idx);
+            UINT64 needle = truncate(haystack, N);
+
+            for (UINT64 i = 0; i < N; i++) {
+                *pred = haystack&1;
+                haystack >>= 1;
+                if (truncate(haystack, N) == needle)
+                    return true;
+            }
+            return false;
+        }
+
+        BOOL makePrediction(ADDRINT address) {
+            BOOL pred;
+            if (predict(address, &pred) && !counter.isTaken(truncate(address, L)))
+                return pred;
+            return altPredictor->makePrediction(address);
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(address, L);
+            BOOL pred, altpred;
+            altpred = altPredictor->makePrediction(address);
+            altPredictor->makeUpdate(takenActually, altpred, address);
+            if (predict(address, &pred)) {
+                if (pred == takenActually && altpred != takenActually)
+                    counter.decrement(idx);
+                else if (pred != takenActually && altpred == takenActually)
+                    counter.increment(idx);
+            } else if (altpred == takenActually) {
+                counter.increment(idx);
+            }
+
+            history.shiftIn(idx, takenActually);
+        }
+
+        UINT64 getSize() {
+            return altPredictor->getSize() + ShiftRegisterArray<L, 2*N>::getSize();
+        }
+};
+
+template<size_t N, size_t L, size_t N2, size_t G2>
+class nBPATGShare : public BranchPredictor {
+    ShiftRegisterArray<L, 2*N> history;
+    SaturatingCounterArray<L, 2> counter;
+    GlobalHistoryPredictor<N2, G2, &f_xor> altPredictor;
+
+    public:
+        nBPATGShare() {
+            assert(getSize() < MAXIMUM_STORAGE_SIZE);
+        }
+
+        BOOL predict(ADDRINT address, BOOL* pred) {
+            UINT64 idx = truncate(address, L);
+            UINT64 haystack = history.getVal(idx);
+            UINT64 needle = truncate(haystack, N);
+
+            for (UINT64 i = 0; i < N; i++) {
+                *pred = haystack&1;
+                haystack >>= 1;
+                if (truncate(haystack, N) == needle)
+                    return true;
+            }
+            return false;
+        }
+
+        BOOL makePrediction(ADDRINT address) {
+            BOOL pred;
+            if (predict(address, &pred) && !counter.isTaken(truncate(address, L)))
+                return pred;
+            return altPredictor.makePrediction(address);
+        }
+
+        void makeUpdate(BOOL takenActually, BOOL takenPredicted, ADDRINT address) {
+            UINT64 idx = truncate(address, L);
+            BOOL pred, altpred;
+            altpred = altPredictor.makePrediction(address);
+            altPredictor.makeUpdate(takenActually, altpred, address);
+            if (predict(address, &pred)) {
+                if (pred == takenActually && altpred != takenActually)
+                    counter.decrement(idx);
+                else if (pred != takenActually && altpred == takenActually)
+                    counter.increment(idx);
+            } else if (altpred == takenActually) {
+                counter.increment(idx);
+            }
+
+            history.shiftIn(idx, takenActually);
+        }
+
+        UINT64 getSize() {
+            return altPredictor.getSize() + ShiftRegisterArray<L, 2*N>::getSize() + SaturatingCounterArray<L, 2>::getSize();
+        }
+};
+
+// The predictor configurations the tools can pick by name, with their
+// accuracy on the lab's SPEC runs where it was measured
+static const char BRANCH_PREDICTOR_NAMES[] =
+    "bht|gshare|local|tournament|alpha21264|tage|nbpatgshare";
+
+// Returns a new predictor of the named configuration, or NULL if the name
+// is not one of BRANCH_PREDICTOR_NAMES
+inline BranchPredictor* makeBranchPredictor(const char* name)
+{
+    // 90% on both SPECINT and SPECFP
+    if (strcmp(name, "bht") == 0)
+        return new BHTPredictor<14>();
+    // 94% on SPECINT, 98% on SPECFP, avg 96%
+    if (strcmp(name, "gshare") == 0)
+        return new GlobalHistoryPredictor<14, 14, &f_xor>();
+    // 87% on SPECINT, 99% on SPECFP, avg 92%
+    if (strcmp(name, "local") == 0)
+        return new LocalHistoryPredictor<14, 14, 6, &f_xor>();
+    // Chooser is indexed by the address bits
+    // 94% on SPECINT, 99% on SPECFP, avg 96%
+    if (strcmp(name, "tournament") == 0)
+        return new TournamentPredictor<12>(
+            new GlobalHistoryPredictor<12, 12, &f_xor>(),
+            new LocalHistoryPredictor<10, 10, 10, &f_b, 3>()
+        );
+    if (strcmp(name, "alpha21264") == 0)
+        return new Alpha21264Predictor<12>();
+    // Geometric history lengths up to 200 branches
+    if (strcmp(name, "tage") == 0)
+        return new TagePredictor<5, 200>(
+            new TageBasePredictor<11, 1>(),
+            new FoldedTagePredictorComponent<9, 9, 6>(),
+            new FoldedTagePredictorComponent<9, 9, 20>(),
+            new FoldedTagePredictorComponent<9, 9, 64>(),
+            new FoldedTagePredictorComponent<9, 9, 200>()
+        );
+    if (strcmp(name, "nbpatgshare") == 0)
+        return new nBPATGShare<12, 10, 11, 12>();
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef BRANCH_TRACE_H
+#define BRANCH_TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "bp_types.h"
+
+// Binary trace of the conditional branches seen by handleBranch().
+//
+// The file starts with the 8 byte magic below and is followed by one
+// record per run of identical branches: the same instruction with the same
+// outcome, executed back to back. A record is a LEB128 varint holding the
+// zigzag-encoded difference between this branch address and the previous
+// record's, shifted left by two, with bit 1 set for taken and bit 0 set
+// when a second varint follows holding the run length minus two. User
+// space addresses are well under 2^61 apart, so no delta loses bits. Most
+// branches cost one or two bytes, and a loop closed by a single branch
+// costs a few bytes per loop.
+static const char BRANCH_TRACE_MAGIC[8] = {'B', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+static const UINT32 BRANCH_TRACE_BUFFER_SIZE = 1u << 20;
+static const UINT32 BRANCH_TRACE_MAX_RECORD = 20;     // two 10 byte varints
+
+class BranchTraceWriter
+{
+        FILE*   file;
+        UINT8*  buf;
+        UINT32  pos;
+        UINT64  prevIp;
+        UINT64  runIp;          // pending run, not yet written
+        BOOL    runTaken;
+        UINT64  runLength;
+        UINT64  numBranches;
+
+        void flush() {
+            if (pos && fwrite(buf, 1, pos, file) != pos)
+                fprintf(stderr, "branch trace: short write\n");
+            pos = 0;
+        }
+
+        void putVarint(UINT64 v) {
+            while (v >= 0x80) {
+                buf[pos++] = (UINT8) (v | 0x80);
+                v >>= 7;
+            }
+            buf[pos++] = (UINT8) v;
+        }
+
+        void writeRun() {
+            if (!runLength)
+                return;
+            INT64 delta = (INT64) (runIp - prevIp);
+            UINT64 zigzag = ((UINT64) delta << 1) ^ (UINT64) (delta >> 63);
+            if (pos + BRANCH_TRACE_MAX_RECORD > BRANCH_TRACE_BUFFER_SIZE)
+                flush();
+            putVarint((zigzag << 2) | (runTaken ? 2 : 0) | (runLength > 1 ? 1 : 0));
+            if (runLength > 1)
+                putVarint(runLength - 2);
+            prevIp = runIp;
+            runLength = 0;
+        }
+
+    public:
+        BranchTraceWriter() : file(NULL), buf(NULL), pos(0), prevIp(0), runIp(0),
+            runTaken(false), runLength(0), numBranches(0) { }
+
+        ~BranchTraceWriter() {
+            close();
+        }
+
+        bool open(const char* path) {
+            file = fopen(path, "wb");
+            if (!file)
+                return false;
+            buf = new UINT8[BRANCH_TRACE_BUFFER_SIZE];
+            return fwrite(BRANCH_TRACE_MAGIC, 1, sizeof(BRANCH_TRACE_MAGIC), file) == sizeof(BRANCH_TRACE_MAGIC);
+        }
+
+        void record(ADDRINT ip, BOOL taken) {
+            numBranches++;
+            if (runLength && ip == runIp && taken == runTaken) {
+                runLength++;
+                return;
+            }
+            writeRun();
+            runIp = ip;
+            runTaken = taken;
+            runLength = 1;
+        }
+
+        UINT64 getNumBranches() {
+            return numBranches;
+        }
+
+        bool isOpen() {
+            return file != NULL;
+        }
+
+        void close() {
+            if (!file)
+                return;
+            writeRun();
+            flush();
+            fclose(file);
+            file = NULL;
+            delete[] buf;
+            buf = NULL;
+        }
+};
+
+class BranchTraceReader
+{
+        FILE*   file;
+        UINT8*  buf;
+        UINT32  pos;
+        UINT32  len;
+        UINT64  prevIp;
+        BOOL    runTaken;
+        UINT64  runLeft;        // branches of the current run still to return
+
+        // Refills the buffer, keeping any partial record at its tail
+        bool refill() {
+            UINT32 rest = len - pos;
+            memmove(buf, buf + pos, rest);
+            len = rest + (UINT32) fread(buf + rest, 1, BRANCH_TRACE_BUFFER_SIZE - rest, file);
+            pos = 0;
+            return len > rest;
+        }
+
+        // Returns false on a truncated varint
+        bool getVarint(UINT64* v) {
+            *v = 0;
+            UINT32 shift = 0;
+            while (pos < len && (buf[pos] & 0x80)) {
+                *v |= (UINT64) (buf[pos++] & 0x7f) << shift;
+                shift += 7;
+            }
+            if (pos == len)
+                return false;
+            *v |= (UINT64) buf[pos++] << shift;
+            return true;
+        }
+
+    public:
+        BranchTraceReader() : file(NULL), buf(NULL), pos(0), len(0), prevIp(0),
+            runTaken(false), runLeft(0) { }
+
+        ~BranchTraceReader() {
+            if (file)
+                fclose(file);
+            delete[] buf;
+        }
+
+        bool open(const char* path) {
+            char magic[sizeof(BRANCH_TRACE_MAGIC)];
+            file = fopen(path, "rb");
+            if (!file)
+                return false;
+            buf = new UINT8[BRANCH_TRACE_BUFFER_SIZE];
+            return fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                memcmp(magic, BRANCH_TRACE_MAGIC, sizeof(magic)) == 0;
+        }
+
+        // Returns false at the end of the trace
+        bool next(ADDRINT* ip, BOOL* taken) {
+            if (runLeft) {
+                runLeft--;
+                *ip = prevIp;
+                *taken = runTaken;
+                return true;
+            }
+
+            if (len - pos < BRANCH_TRACE_MAX_RECORD && !refill() && pos == len)
+                return false;
+
+            UINT64 v, extra = 0;
+            if (!getVarint(&v) || ((v & 1) && !getVarint(&extra)))
+                return false; // truncated record
+
+            UINT64 zigzag = v >> 2;
+            INT64 delta = (INT64) (zigzag >> 1) ^ -(INT64) (zigzag & 1);
+            prevIp += (UINT64) delta;
+            runTaken = (v & 2) != 0;
+            runLeft = (v & 1) ? extra + 1 : 0;
+            *ip = prevIp;
+            *taken = runTaken;
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef PREDICTOR_BANK_H
+#define PREDICTOR_BANK_H
+
+// A bank of predictors fed the same branch stream in one pass. The
+// predictors are dealt round-robin to worker threads; the producer copies
+// every branch into each worker's single-producer single-consumer ring and
+// the worker runs its predictors over it, so the predictors are simulated
+// in parallel and each sees exactly the stream a single run would.
+#include <string>
+#include <vector>
+#include "branch_predictors.h"
+#ifdef BPREDICTOR_STANDALONE
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static const UINT32 BANK_RING_SIZE = 1u << 16;     // records, a power of two
+static const UINT32 BANK_BATCH = 256;              // records per index publish
+static const UINT32 BANK_CACHE_LINE = 64;
+
+// Outcome counts of one predictor, printed like the bpredictor result file
+struct PredictorStats
+{
+    UINT64 takenCorrect;
+    UINT64 takenIncorrect;
+    UINT64 notTakenCorrect;
+    UINT64 notTakenIncorrect;
+
+    PredictorStats() : takenCorrect(0), takenIncorrect(0), notTakenCorrect(0), notTakenIncorrect(0) { }
+
+    void record(BOOL prediction, BOOL direction) {
+        if (prediction) {
+            if (direction)
+                takenCorrect++;
+            else
+                takenIncorrect++;
+        } else {
+            if (direction)
+                notTakenIncorrect++;
+            else
+                notTakenCorrect++;
+        }
+    }
+
+    void print(FILE* outFile) {
+        fprintf(outFile, "takenCorrect %lu  takenIncorrect %lu notTakenCorrect %lu notTakenIncorrect %lu\n", takenCorrect, takenIncorrect, notTakenCorrect, notTakenIncorrect);
+    }
+};
+
+struct BranchRecord
+{
+    UINT64 ip;
+    UINT64 taken;
+};
+
+// Single-producer single-consumer ring of branch records. Each side keeps
+// its index private and publishes it only every BANK_BATCH records, or
+// when it has to wait. The two sides are padded apart so the threads
+// rarely share a cache line.
+class BranchRing
+{
+        BranchRecord* slots;
+        UINT8   pad0[BANK_CACHE_LINE];
+
+        // Producer side
+        UINT64  tail;           // published
+        UINT64  localTail;
+        UINT64  cachedHead;
+        UINT32  done;
+        UINT8   pad1[BANK_CACHE_LINE];
+
+        // Consumer side
+        UINT64  head;           // published
+        UINT64  localHead;
+        UINT64  cachedTail;
+        UINT8   pad2[BANK_CACHE_LINE];
+
+        static void yield() {
+#ifdef BPREDICTOR_STANDALONE
+            sched_yield();
+#else
+            PIN_Yield();
+#endif
+        }
+
+    public:
+        BranchRing() : tail(0), localTail(0), cachedHead(0), done(0), head(0), localHead(0), cachedTail(0) {
+            slots = new BranchRecord[BANK_RING_SIZE];
+        }
+
+        ~BranchRing() {
+            delete[] slots;
+        }
+
+        void push(ADDRINT ip, BOOL taken) {
+            if (localTail - cachedHead == BANK_RING_SIZE) {
+                __atomic_store_n(&tail, localTail, __ATOMIC_RELEASE);
+                while ((cachedHead = __atomic_load_n(&head, __ATOMIC_ACQUIRE)) + BANK_RING_SIZE == localTail)
+                    yield();
+            }
+            BranchRecord& r = slots[localTail & (BANK_RING_SIZE - 1)];
+            r.ip = ip;
+            r.taken = taken;
+            if (++localTail % BANK_BATCH == 0)
+                __atomic_store_n(&tail, localTail, __ATOMIC_RELEASE);
+        }
+
+        // Publishes the rest of the stream and ends it
+        void close() {
+            __atomic_store_n(&tail, localTail, __ATOMIC_RELEASE);
+            __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+        }
+
+        // Returns false once the stream is closed and drained
+        bool pop(BranchRecord* r) {
+            while (localHead == cachedTail) {
+                __atomic_store_n(&head, localHead, __ATOMIC_RELEASE);
+                cachedTail = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+                if (localHead != cachedTail)
+                    break;
+                if (__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+                    cachedTail = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+                    if (localHead == cachedTail)
+                        return false;
+                    break;
+                }
+                yield();
+            }
+            *r = slots[localHead & (BANK_RING_SIZE - 1)];
+            if (++localHead % BANK_BATCH == 0)
+                __atomic_store_n(&head, localHead, __ATOMIC_RELEASE);
+            return true;
+        }
+};
+
+class PredictorBank
+{
+        struct Worker
+        {
+            BranchRing                  ring;
+            std::vector<UINT32>         predictors;     // indices into the bank
+            std::vector<PredictorStats> stats;          // of each, kept here until finish()
+            PredictorBank*              bank;
+#ifdef BPREDICTOR_STANDALONE
+            pthread_t                   thread;
+#else
+            PIN_THREAD_UID              thread;
+#endif
+        };
+
+        std::vector<std::string>        names;
+        std::vector<BranchPredictor*>   predictors;
+        std::vector<PredictorStats>     stats;
+        std::vector<Worker*>            workers;
+
+        void run(Worker* w) {
+            BranchRecord r;
+            while (w->ring.pop(&r)) {
+                for (UINT32 i = 0; i < w->predictors.size(); i++) {
+                    UINT32 p = w->predictors[i];
+                    BOOL prediction = predictors[p]->makePrediction(r.ip);
+                    predictors[p]->makeUpdate(r.taken, prediction, r.ip);
+                    w->stats[i].record(prediction, r.taken);
+                }
+            }
+        }
+
+#ifdef BPREDICTOR_STANDALONE
+        static void* workerMain(void* arg) {
+            ((Worker*) arg)->bank->run((Worker*) arg);
+            return NULL;
+        }
+#else
+        static VOID workerMain(VOID* arg) {
+            ((Worker*) arg)->bank->run((Worker*) arg);
+        }
+#endif
+
+    public:
+        // Builds the predictors of a comma-separated list of
+        // makeBranchPredictor() names; valid() is false if any is unknown
+        PredictorBank(const char* config) {
+            std::string list(config);
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t end = list.find(',', start);
+                if (end == std::string::npos)
+                    end = list.size();
+                names.push_back(list.substr(start, end - start));
+                predictors.push_back(makeBranchPredictor(names.back().c_str()));
+                start = end + 1;
+            }
+            stats.resize(predictors.size());
+        }
+
+        bool valid() {
+            for (UINT32 p = 0; p < predictors.size(); p++)
+                if (!predictors[p])
+                    return false;
+            return true;
+        }
+
+        UINT32 size() {
+            return predictors.size();
+        }
+
+        BranchPredictor* getPredictor(UINT32 p) {
+            return predictors[p];
+        }
+
+        // Starts numWorkers threads, at most one per predictor. Returns
+        // false if a thread could not be created.
+        bool start(UINT32 numWorkers) {
+            assert(valid() && numWorkers > 0);
+            if (numWorkers > predictors.size())
+                numWorkers = predictors.size();
+            for (UINT32 w = 0; w < numWorkers; w++) {
+                workers.push_back(new Worker);
+                workers[w]->bank = this;
+            }
+            for (UINT32 p = 0; p < predictors.size(); p++) {
+                workers[p % numWorkers]->predictors.push_back(p);
+                workers[p % numWorkers]->stats.push_back(PredictorStats());
+            }
+            for (UINT32 w = 0; w < numWorkers; w++) {
+#ifdef BPREDICTOR_STANDALONE
+                if (pthread_create(&workers[w]->thread, NULL, workerMain, workers[w]) != 0)
+                    return false;
+#else
+                if (PIN_SpawnInternalThread(workerMain, workers[w], 0, &workers[w]->thread) == INVALID_THREADID)
+                    return false;
+#endif
+            }
+            return true;
+        }
+
+        // Hands one branch to every worker. Only one thread may call this.
+        void record(ADDRINT ip, BOOL taken) {
+            for (UINT32 w = 0; w < workers.size(); w++)
+                workers[w]->ring.push(ip, taken);
+        }
+
+        // Ends the stream and waits for the workers to drain it
+        void finish() {
+            for (UINT32 w = 0; w < workers.size(); w++)
+                workers[w]->ring.close();
+            for (UINT32 w = 0; w < workers.size(); w++) {
+#ifdef BPREDICTOR_STANDALONE
+                pthread_join(workers[w]->thread, NULL);
+#else
+                PIN_WaitForThreadTermination(workers[w]->thread, PIN_INFINITE_TIMEOUT, NULL);
+#endif
+                for (UINT32 i = 0; i < workers[w]->predictors.size(); i++)
+                    stats[workers[w]->predictors[i]] = workers[w]->stats[i];
+                delete workers[w];
+            }
+            workers.clear();
+        }
+
+        // Writes one line per predictor, in config order: its name, then
+        // the counts in the bpredictor result format
+        void dumpResults(FILE* outFile) {
+            for (UINT32 p = 0; p < predictors.size(); p++) {
+                fprintf(outFile, "%s ", names[p].c_str());
+                stats[p].print(outFile);
+            }
+        }
+};
+
+#endif